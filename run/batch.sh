@@ -0,0 +1,109 @@
+#!/bin/bash
+
+# Runs many simulations concurrently, each one in its own directory and with its own access key,
+# and writes a summary with the result (pass, fail or deadlock) and the wall time of every run.
+#
+# A run passes when the simulator terminates normally and every group ends in state 7 (LEAVING);
+# it is taken as deadlocked when it does not terminate before the timeout, or when the watchdog of the
+# simulator ends it (status 3, the state of the entities is then reported in err.txt).
+# The latencies of the groups of all the runs are added up in latency.txt.
+# The scenario (a text file, default config.txt) is copied into every directory; longmeal.txt, in which a
+# meal lasts longer than the watchdog time, is a regression run for the watchdog:
+#     ./batch.sh -c longmeal.txt -t 15 4
+
+usage() {
+    echo "USAGE: $0 [-j jobs] [-t timeout] [-o outdir] [-x program] [-c scenario] [«number-of-runs»] [-- simulator-options]"
+    exit 1
+}
+
+jobs=$(nproc)
+tmout=10
+outdir=batch
+prog=probSemSharedMemRestaurant
+scen=config.txt
+while getopts "j:t:o:x:c:" opt; do
+    case $opt in
+        j) jobs=$OPTARG;;
+        t) tmout=$OPTARG;;
+        o) outdir=$OPTARG;;
+        x) prog=$OPTARG;;
+        c) scen=$OPTARG;;
+        *) usage;;
+    esac
+done
+shift $((OPTIND-1))
+n=1000
+if [ $# -gt 0 ] && [ "$1" != "--" ]; then
+    n=$1
+    shift
+fi
+[ "$1" == "--" ] && shift
+
+if ! [ $n -gt 0 ] 2>/dev/null || ! [ $jobs -gt 0 ] 2>/dev/null || ! [ $tmout -gt 0 ] 2>/dev/null; then
+    echo "Wrong argument value. Aborting."
+    exit 1
+fi
+if ! [ -x ./$prog ]; then
+    echo "./$prog not found. Aborting."
+    exit 1
+fi
+if ! [ -f $scen ]; then
+    echo "$scen not found. Aborting."
+    exit 1
+fi
+
+rm -rf $outdir
+mkdir -p $outdir
+
+# keys of this batch: 16 bits from the pid of the script, 16 bits from the run number
+export RUNDIR=$(pwd) SCEN=$(cd $(dirname $scen) && pwd)/$(basename $scen) OUTDIR=$(cd $outdir && pwd) PROG=$prog TMOUT=$tmout KEYBASE=$(( ($$ & 0x3fff) << 16 ))
+export SIMOPTS="$*"
+
+runOne() {
+    local i=$1
+    local dir=$OUTDIR/run_$i
+    local key=$(( KEYBASE + i ))
+    local start end rc result
+
+    mkdir -p $dir
+    for f in chef waiter group receptionist $PROG; do
+        ln -sf $RUNDIR/$f $dir/$f
+    done
+    cp $SCEN $dir/config.txt
+
+    cd $dir
+    start=$(date +%s%N)
+    timeout $TMOUT ./$PROG -k $key -H $OUTDIR/latency.txt $SIMOPTS log.txt > out.txt 2> err.txt
+    rc=$?
+    end=$(date +%s%N)
+
+    if [ $rc -eq 124 ] || [ $rc -eq 137 ]; then
+        result=deadlock
+        ipcrm -M $key -S $key 2> /dev/null
+        ipcrm -M $(( key ^ 0x7f000000 )) -M $(( key ^ 0x7e000000 )) 2> /dev/null
+    elif [ $rc -eq 3 ]; then
+        result=deadlock
+    elif [ $rc -ne 0 ]; then
+        result=fail
+    else
+        # the group columns follow one column per chef and per waiter, so they are located from the header
+        ngroups=$( head -2 config.txt | tail -1 )
+        g0=$( sed -n 3p log.txt 2> /dev/null | awk '{ for (i = 1; i <= NF; i++) if ($i == "G00") print i }' )
+        if [ -n "$g0" ] && tail -1 log.txt | awk -v ng=$ngroups -v g0=$g0 '{ for (i = g0; i < g0+ng; i++) if ($i != 7) exit 1 }'; then
+            result=pass
+        else
+            result=fail
+        fi
+    fi
+    echo "$i,$result,$rc,$(( (end - start) / 1000000 ))"
+}
+export -f runOne
+
+echo "run,result,status,wall_ms" > $outdir/summary.csv
+seq 1 $n | xargs -P $jobs -I{} bash -c 'runOne {}' | sort -t, -k1,1n >> $outdir/summary.csv
+
+awk -F, 'NR > 1 { c[$2]++; t += $4; if ($4 > max) max = $4 }
+         END    { printf "%d runs: %d pass, %d fail, %d deadlock; wall time mean %.1f ms, max %d ms\n",
+                         NR-1, c["pass"], c["fail"], c["deadlock"], t/(NR-1), max }' $outdir/summary.csv
+[ -f $outdir/latency.txt ] && grep '^#' $outdir/latency.txt | cut -c3-
+echo "summary in $outdir/summary.csv"
@@ -0,0 +1,116 @@
+#!/bin/bash
+
+# Scaling benchmark: runs the same sweep of generated scenarios with every semaphore backend and writes
+# one CSV line per run, for plotting.
+#
+# The programs of each backend are expected in bench/«backend» (svipc, futex, threaded and sim), built with
+# the semaphore statistics (SEMSTATS=1), as "make bench" in src does. A scenario is generated, compiled
+# (genScenario -B), for every point of the sweep (every combination of the numbers of groups, tables,
+# waiters and chefs) and run by every backend, all with the same seed.
+#
+# Columns: backend, groups, tables, waiters, chefs, repetition, result (pass, fail or deadlock), exit
+# status, wall time (s), groups served per second of wall time, downs of MUTEX, time MUTEX was held (us)
+# and per down (us), and system calls made by the semaphore operations of all the entities. With the sim
+# backend the times of the semaphore statistics are virtual, the wall time is not.
+
+usage() {
+    echo "USAGE: $0 [-g groups] [-t tables] [-w waiters] [-c chefs] [-b backends] [-r repetitions] [-T horizon] [-E mean] [-x timeout] [-o file] [-- simulator-options]"
+    echo "       (the lists of groups, tables, waiters, chefs and backends are quoted and separated by spaces)"
+    exit 1
+}
+
+groups="50 200 800"
+tables="4 16"
+waiters="1 4"
+chefs="1 4"
+backends="svipc futex threaded sim"
+reps=1
+horizon=200000
+eatMean=2000
+tmout=60
+out=bench/bench.csv
+while getopts "g:t:w:c:b:r:T:E:x:o:" opt; do
+    case $opt in
+        g) groups=$OPTARG;;
+        t) tables=$OPTARG;;
+        w) waiters=$OPTARG;;
+        c) chefs=$OPTARG;;
+        b) backends=$OPTARG;;
+        r) reps=$OPTARG;;
+        T) horizon=$OPTARG;;
+        E) eatMean=$OPTARG;;
+        x) tmout=$OPTARG;;
+        o) out=$OPTARG;;
+        *) usage;;
+    esac
+done
+shift $((OPTIND-1))
+[ "$1" == "--" ] && shift
+simopts="$*"
+
+if ! [ $reps -gt 0 ] 2>/dev/null || ! [ $tmout -gt 0 ] 2>/dev/null; then
+    echo "Wrong argument value. Aborting."
+    exit 1
+fi
+for b in $backends; do
+    case $b in
+        threaded) prog=restaurantThreaded;;
+        svipc|futex|sim) prog=probSemSharedMemRestaurant;;
+        *) echo "Unknown backend $b. Aborting."; exit 1;;
+    esac
+    if ! [ -x bench/$b/$prog ]; then
+        echo "bench/$b/$prog not found (see make bench). Aborting."
+        exit 1
+    fi
+done
+gen=$(ls bench/*/genScenario 2> /dev/null | head -1)
+if [ -z "$gen" ]; then
+    echo "genScenario not found in bench (see make bench). Aborting."
+    exit 1
+fi
+
+# keys of this sweep: 16 bits from the pid of the script, 16 bits from the run number
+keybase=$(( ($$ & 0x3fff) << 16 ))
+run=0
+
+mkdir -p $(dirname $out)
+echo "backend,groups,tables,waiters,chefs,rep,result,status,wall_s,groups_per_s,mutex_downs,mutex_hold_us,hold_per_down_us,syscalls" > $out
+for g in $groups; do
+  for t in $tables; do
+    for w in $waiters; do
+      for c in $chefs; do
+        scen=$(pwd)/bench/scen_${g}_${t}_${w}_${c}.bin
+        $gen -g $g -t $t -w $w -C $c -T $horizon -E $eatMean -B -o $scen || exit 1
+        for b in $backends; do
+          prog=probSemSharedMemRestaurant
+          [ $b == threaded ] && prog=restaurantThreaded
+          for r in $(seq 1 $reps); do
+            run=$(( run + 1 ))
+            key=$(( keybase + run ))
+            start=$(date +%s%N)
+            ( cd bench/$b && timeout $tmout ./$prog -k $key -s $r -c $scen $simopts log.txt > out.txt 2> err.txt )
+            rc=$?
+            end=$(date +%s%N)
+            if [ $rc -eq 124 ] || [ $rc -eq 137 ] || [ $rc -eq 3 ]; then
+                result=deadlock
+                ipcrm -M $key -S $key 2> /dev/null
+                ipcrm -M $(( key ^ 0x7f000000 )) -M $(( key ^ 0x7e000000 )) 2> /dev/null
+            elif [ $rc -ne 0 ]; then
+                result=fail
+            else
+                result=pass
+            fi
+            # the rows of the semaphore statistics have 8 columns: entity, semaphore, downs, ups, wait, max, hold, syscalls
+            stats=$( awk 'NF == 8 && $1 ~ /^(receptionist|waiters|chefs|groups)$/ {
+                              sys += $8; if ($2 == "MUTEX") { downs += $3; hold += $7 } }
+                          END { printf "%d,%.1f,%.3f,%d", downs, hold, (downs > 0) ? hold / downs : 0, sys }' bench/$b/out.txt )
+            awk -v b=$b -v g=$g -v t=$t -v w=$w -v c=$c -v r=$r -v res=$result -v rc=$rc -v ns=$(( end - start )) -v st="$stats" \
+                'BEGIN { printf "%s,%d,%d,%d,%d,%d,%s,%d,%.3f,%.1f,%s\n", b, g, t, w, c, r, res, rc, ns / 1e9, g / (ns / 1e9), st }' >> $out
+            tail -1 $out
+          done
+        done
+      done
+    done
+  done
+done
+echo "results in $out"
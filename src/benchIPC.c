@@ -0,0 +1,256 @@
+/**
+ *  \file benchIPC.c (implementation file)
+ *
+ *  \brief Microbenchmarks of the primitives defined in semaphore.h and sharedMemory.h.
+ *
+ *  Measures, with the semaphore backend the program is linked with:
+ *    \li pingpong: round trip of a <em>up</em> / <em>down</em> exchange between two processes
+ *    \li updown: uncontended <em>up</em> followed by <em>down</em> of a semaphore
+ *    \li batch: the same pair of operations issued as a single batch
+ *    \li mutex: throughput of a critical region (a shared counter) entered by 2 .. N processes
+ *    \li shm_create, shm_attach, shm_dettach, shm_destroy: cost of a shared memory block life cycle.
+ *
+ *  The results are printed in CSV format, one line per measurement:
+ *  <tt>backend,benchmark,processes,operations,total_ns,ns_per_op</tt>.
+ *
+ *  Options:
+ *    \li -n operations  number of operations of the semaphore benchmarks (default 100000)
+ *    \li -p processes  largest number of processes of the mutex benchmark (default 4)
+ *    \li -m cycles  number of shared memory block life cycles (default 1000)
+ *    \li -s size  size in bytes of the shared memory block (default 1 MiB).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "semaphore.h"
+#include "sharedMemory.h"
+#include "simClock.h"
+
+#ifndef BACKEND
+/** \brief name of the semaphore backend (set by the Makefile) */
+#define  BACKEND        "svipc"
+#endif
+
+/* semaphores of the set */
+#define  PING           1
+#define  PONG           2
+#define  ALONE          3
+#define  LOCK           4
+#define  READY          5
+#define  GO             6
+#define  NSEMS          6
+
+/** \brief semaphore set access identifier */
+static int semgid;
+
+/** \brief counter updated in the critical region of the mutex benchmark */
+static unsigned long *counter;
+
+/* internal functions */
+
+static unsigned long long now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000 + (unsigned long long) ts.tv_nsec;
+}
+
+static void check (int stat, const char *what)
+{
+    if (stat == -1) {
+        perror (what);
+        exit (EXIT_FAILURE);
+    }
+}
+
+static void report (const char *bench, unsigned int procs, unsigned long ops, unsigned long long ns)
+{
+    printf ("%s,%s,%u,%lu,%llu,%.1f\n", BACKEND, bench, procs, ops, ns, (double) ns / ops);
+    fflush (stdout);
+}
+
+static pid_t spawn (void (*body) (unsigned long), unsigned long n)
+{
+    pid_t pid;
+
+    check (pid = fork (), "error on the fork operation");
+    if (pid == 0) {
+        body (n);
+        simDone (semgid);
+        exit (EXIT_SUCCESS);
+    }
+    return pid;
+}
+
+static void reap (unsigned int procs)
+{
+    int status;
+
+    while (procs-- > 0) {
+        check (wait (&status), "error on waiting for a child process");
+        if (!WIFEXITED (status) || (WEXITSTATUS (status) != EXIT_SUCCESS)) {
+            fprintf (stderr, "A child process failed!\n");
+            exit (EXIT_FAILURE);
+        }
+    }
+}
+
+static void pong (unsigned long n)
+{
+    while (n-- > 0) {
+        check (semDown (semgid, PING), "error on the down operation");
+        check (semUp (semgid, PONG), "error on the up operation");
+    }
+}
+
+static void contender (unsigned long n)
+{
+    check (semUp (semgid, READY), "error on the up operation");
+    check (semDown (semgid, GO), "error on the down operation");
+    while (n-- > 0) {
+        check (semDown (semgid, LOCK), "error on the down operation");
+        *counter += 1;
+        check (semUp (semgid, LOCK), "error on the up operation");
+    }
+}
+
+static void benchPingPong (unsigned long n)
+{
+    unsigned long long t0;
+    unsigned long k;
+
+    simEntities (semgid, 2);
+    spawn (pong, n);
+    t0 = now ();
+    for (k = 0; k < n; k++) {
+        check (semUp (semgid, PING), "error on the up operation");
+        check (semDown (semgid, PONG), "error on the down operation");
+    }
+    report ("pingpong", 2, n, now () - t0);
+    reap (1);
+}
+
+static void benchUpDown (unsigned long n)
+{
+    SEMOP pair[] = {{ALONE, SEMUP}, {ALONE, SEMDOWN}};
+    unsigned long long t0;
+    unsigned long k;
+
+    simEntities (semgid, 1);
+    t0 = now ();
+    for (k = 0; k < n; k++) {
+        check (semUp (semgid, ALONE), "error on the up operation");
+        check (semDown (semgid, ALONE), "error on the down operation");
+    }
+    report ("updown", 1, n, now () - t0);
+
+    t0 = now ();
+    for (k = 0; k < n; k++)
+        check (semOpBatch (semgid, pair, 2), "error on the batch operation");
+    report ("batch", 1, n, now () - t0);
+}
+
+static void benchMutex (unsigned long n, unsigned int procs)
+{
+    SEMOP go = {GO, (int) procs};
+    unsigned long long t0;
+    unsigned int p;
+
+    *counter = 0;
+    simEntities (semgid, 1 + procs);
+    for (p = 0; p < procs; p++)
+        spawn (contender, n / procs);
+    for (p = 0; p < procs; p++)                                              /* all the contenders are ready */
+        check (semDown (semgid, READY), "error on the down operation");
+    t0 = now ();
+    check (semOpBatch (semgid, &go, 1), "error on the batch operation");
+    reap (procs);
+    report ("mutex", procs, n / procs * procs, now () - t0);
+    if (*counter != n / procs * procs) {
+        fprintf (stderr, "Mutual exclusion failed: %lu updates instead of %lu!\n", *counter, n / procs * procs);
+        exit (EXIT_FAILURE);
+    }
+}
+
+static void benchShmem (int key, unsigned long cycles, unsigned int size)
+{
+    unsigned long long t[4] = {0, 0, 0, 0}, t0;
+    unsigned long k;
+    void *add;
+    int shmid;
+
+    for (k = 0; k < cycles; k++) {
+        t0 = now ();
+        check (shmid = shmemCreate (key, size), "error on creating the shared memory block");
+        t[0] += now () - t0;
+        t0 = now ();
+        check (shmemAttach (shmid, &add), "error on mapping the shared memory block");
+        t[1] += now () - t0;
+        t0 = now ();
+        check (shmemDettach (add), "error on unmapping the shared memory block");
+        t[2] += now () - t0;
+        t0 = now ();
+        check (shmemDestroy (shmid), "error on destructing the shared memory block");
+        t[3] += now () - t0;
+    }
+    report ("shm_create", 1, cycles, t[0]);
+    report ("shm_attach", 1, cycles, t[1]);
+    report ("shm_dettach", 1, cycles, t[2]);
+    report ("shm_destroy", 1, cycles, t[3]);
+}
+
+/**
+ *  \brief Main program.
+ */
+int main (int argc, char *argv[])
+{
+    unsigned long n = 100000, cycles = 1000;
+    unsigned int maxProcs = 4, size = 1 << 20, p;
+    int key, shmid, opt;
+    char *tinp;
+
+    while ((opt = getopt (argc, argv, "n:p:m:s:")) != -1) {
+        switch (opt) {
+            case 'n': n = strtoul (optarg, &tinp, 0); break;
+            case 'p': maxProcs = (unsigned int) strtoul (optarg, &tinp, 0); break;
+            case 'm': cycles = strtoul (optarg, &tinp, 0); break;
+            case 's': size = (unsigned int) strtoul (optarg, &tinp, 0); break;
+            default: tinp = "?";
+        }
+        if (*tinp != '\0') {
+            fprintf (stderr, "USAGE: %s [-n operations] [-p processes] [-m cycles] [-s size]\n", argv[0]);
+            exit (EXIT_FAILURE);
+        }
+    }
+    if ((n == 0) || (maxProcs < 2) || (cycles == 0) || (size == 0)) {
+        fprintf (stderr, "Wrong argument value!\n");
+        exit (EXIT_FAILURE);
+    }
+
+    /* the keys are derived from the process id, so that several benchmarks may run at the same time */
+    key = (int) (getpid () & 0x3fffff) << 8;
+    check (semgid = semCreate (key, NSEMS), "error on creating the semaphore set");
+    check (semUp (semgid, LOCK), "error on the up operation");
+    check (shmid = shmemCreate (key + 1, sizeof (unsigned long)), "error on creating the shared memory block");
+    check (shmemAttach (shmid, (void **) &counter), "error on mapping the shared memory block");
+    check (semSignal (semgid), "error on signaling start of operations");
+
+    printf ("backend,benchmark,processes,operations,total_ns,ns_per_op\n");
+    benchUpDown (n);
+    benchPingPong (n);
+    for (p = 2; p <= maxProcs; p++)
+        benchMutex (n, p);
+    benchShmem (key + 2, cycles, size);
+
+    check (shmemDettach (counter), "error on unmapping the shared memory block");
+    check (shmemDestroy (shmid), "error on destructing the shared memory block");
+    check (semDestroy (semgid), "error on destructing the semaphore set");
+    return EXIT_SUCCESS;
+}
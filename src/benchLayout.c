@@ -0,0 +1,212 @@
+/**
+ *  \file benchLayout.c (implementation file)
+ *
+ *  \brief Microbenchmark of the layout of the shared region defined in sharedDataSync.h.
+ *
+ *  Lays out a shared region as the simulation does and starts 1 .. N processes, each one repeatedly
+ *  writing the fields of the shared region that belong to a single lock, without taking it, as they
+ *  would if the locks were split or the queues lock-free:
+ *    \li state: the sequence number, the number of groups waiting and the state of a group and of a waiter
+ *    \li kitchen: the positions and the entries of the food orders
+ *    \li waiter: the positions and the entries of the dishes ready and of the waiter queue
+ *    \li reception: the positions and the entries of the receptionist queue
+ *    \li config: reads of the sizes and of the start and eat times (no writes).
+ *
+ *  The processes are given the kinds in this order, over and over. As no field is written by two of
+ *  them, any slowdown when they run on different cores is caused by false sharing. The program is
+ *  built twice by <tt>make benchlayout</tt>: benchLayout with the packed layout and benchLayoutAligned
+ *  with the cache-aligned one (CACHEALIGN defined).
+ *
+ *  The results are printed in CSV format, one line per number of processes:
+ *  <tt>layout,processes,operations,total_ns,ns_per_op</tt>, where an operation is a round of writes
+ *  (or reads) by every process and the time is the wall time of all of them.
+ *
+ *  Options:
+ *    \li -n operations  number of rounds of each process (default 10000000)
+ *    \li -p processes  largest number of processes (default 5)
+ *    \li -g groups  number of groups of the region (default 1000).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "probConst.h"
+#include "probDataStruct.h"
+#include "sharedDataSync.h"
+#include "sharedMemory.h"
+
+#ifdef CACHEALIGN
+#define  LAYOUT         "aligned"
+#else
+#define  LAYOUT         "packed"
+#endif
+
+/* kinds of processes */
+#define  KSTATE         0
+#define  KKITCHEN       1
+#define  KWAITER        2
+#define  KRECEPTION     3
+#define  KCONFIG        4
+#define  NKINDS         5
+
+/** \brief shared region */
+static SHARED_DATA *sh;
+
+/** \brief start flags of the processes (in a block of their own, so they do not disturb the region) */
+static volatile unsigned int *flags;
+
+/** \brief number of processes ready to start */
+#define  READY          (flags[0])
+/** \brief start of the measurement flag */
+#define  GO             (flags[1])
+/** \brief sum of the values read by the config processes (keeps the reads from being optimized away) */
+#define  SINK           (flags[2])
+
+/* internal functions */
+
+static unsigned long long now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000 + (unsigned long long) ts.tv_nsec;
+}
+
+static void check (int stat, const char *what)
+{
+    if (stat == -1) {
+        perror (what);
+        exit (EXIT_FAILURE);
+    }
+}
+
+/* writes of a single field (relaxed atomics, so that every one of them reaches the cache) */
+#define  BUMP(f)        __atomic_store_n (&(f), (f) + 1, __ATOMIC_RELAXED)
+#define  SET(f,v)       __atomic_store_n (&(f), (v), __ATOMIC_RELAXED)
+#define  GET(f)         __atomic_load_n (&(f), __ATOMIC_RELAXED)
+
+static void worker (unsigned int kind, unsigned long n)
+{
+    FULL_STAT *p_fSt = &sh->fSt;
+    unsigned int sum = 0, g;
+    unsigned long k;
+
+    __atomic_fetch_add (&READY, 1, __ATOMIC_RELEASE);
+    while (__atomic_load_n (&GO, __ATOMIC_ACQUIRE) == 0);
+    for (k = 0; k < n; k++) {
+        g = (unsigned int) (k % (unsigned long) p_fSt->nGroups);
+        switch (kind) {
+            case KSTATE:
+                BUMP (p_fSt->seq);
+                SET (p_fSt->groupsWaiting, (int) g);
+                SET (GROUPSTAT(p_fSt)[g], k & 7);
+                SET (WAITERSTAT(p_fSt)[0], k & 3);
+                BUMP (p_fSt->seq);
+                break;
+            case KKITCHEN:
+                SET (ORDERGROUP(p_fSt)[g], (int) g);
+                BUMP (p_fSt->orderHead);
+                BUMP (p_fSt->orderTail);
+                break;
+            case KWAITER:
+                SET (READYGROUP(p_fSt)[g], (int) g);
+                BUMP (p_fSt->readyHead);
+                SET (p_fSt->waiterQueue.slot[k % REQQUEUESIZE].reqGroup, (int) g);
+                BUMP (p_fSt->waiterQueue.head);
+                BUMP (p_fSt->waiterQueue.tail);
+                break;
+            case KRECEPTION:
+                SET (p_fSt->receptionistQueue.slot[k % REQQUEUESIZE].reqGroup, (int) g);
+                BUMP (p_fSt->receptionistQueue.head);
+                BUMP (p_fSt->receptionistQueue.tail);
+                break;
+            default:
+                sum += (unsigned int) (GET (STARTTIME(p_fSt)[g]) + GET (EATTIME(p_fSt)[g]) + GET (p_fSt->nTables));
+        }
+    }
+    __atomic_fetch_add (&SINK, sum, __ATOMIC_RELAXED);
+}
+
+static void run (unsigned long n, unsigned int procs)
+{
+    unsigned long long t0;
+    unsigned int p;
+    pid_t pid;
+    int status;
+
+    READY = 0;
+    GO = 0;
+    for (p = 0; p < procs; p++) {
+        check (pid = fork (), "error on the fork operation");
+        if (pid == 0) {
+            worker (p % NKINDS, n);
+            exit (EXIT_SUCCESS);
+        }
+    }
+    while (__atomic_load_n (&READY, __ATOMIC_ACQUIRE) < procs);        /* all the processes are ready */
+    t0 = now ();
+    __atomic_store_n (&GO, 1, __ATOMIC_RELEASE);
+    for (p = 0; p < procs; p++) {
+        check (wait (&status), "error on waiting for a child process");
+        if (!WIFEXITED (status) || (WEXITSTATUS (status) != EXIT_SUCCESS)) {
+            fprintf (stderr, "A child process failed!\n");
+            exit (EXIT_FAILURE);
+        }
+    }
+    t0 = now () - t0;
+    printf ("%s,%u,%lu,%llu,%.2f\n", LAYOUT, procs, n, t0, (double) t0 / n);
+    fflush (stdout);
+}
+
+/**
+ *  \brief Main program.
+ */
+int main (int argc, char *argv[])
+{
+    unsigned long n = 10000000;
+    unsigned int maxProcs = NKINDS, p;
+    int nGroups = 1000, key, shmid, flagsid, opt;
+    char *tinp;
+
+    while ((opt = getopt (argc, argv, "n:p:g:")) != -1) {
+        switch (opt) {
+            case 'n': n = strtoul (optarg, &tinp, 0); break;
+            case 'p': maxProcs = (unsigned int) strtoul (optarg, &tinp, 0); break;
+            case 'g': nGroups = (int) strtol (optarg, &tinp, 0); break;
+            default: tinp = "?";
+        }
+        if (*tinp != '\0') {
+            fprintf (stderr, "USAGE: %s [-n operations] [-p processes] [-g groups]\n", argv[0]);
+            exit (EXIT_FAILURE);
+        }
+    }
+    if ((n == 0) || (maxProcs == 0) || (nGroups < 1)) {
+        fprintf (stderr, "Wrong argument value!\n");
+        exit (EXIT_FAILURE);
+    }
+
+    /* the keys are derived from the process id, so that several benchmarks may run at the same time */
+    key = (int) (getpid () & 0x3fffff) << 8;
+    check (shmid = shmemCreate (key, (unsigned int) layoutSharedData (NULL, nGroups, (nGroups + 9) / 10, 1, 1,
+                                                                      LOG_TEXT)),
+           "error on creating the shared region");
+    check (shmemAttach (shmid, (void **) &sh), "error on mapping the shared region");
+    layoutSharedData (sh, nGroups, (nGroups + 9) / 10, 1, 1, LOG_TEXT);
+    check (flagsid = shmemCreate (key + 1, 3 * sizeof (unsigned int)), "error on creating the shared memory block");
+    check (shmemAttach (flagsid, (void **) &flags), "error on mapping the shared memory block");
+
+    printf ("layout,processes,operations,total_ns,ns_per_op\n");
+    fflush (stdout);                                                   /* not to be copied to the children */
+    for (p = 1; p <= maxProcs; p++)
+        run (n, p);
+
+    check (shmemDettach ((void *) flags), "error on unmapping the shared memory block");
+    check (shmemDestroy (flagsid), "error on destructing the shared memory block");
+    check (shmemDettach (sh), "error on unmapping the shared region");
+    check (shmemDestroy (shmid), "error on destructing the shared region");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+/**
+ *  \file genScenario.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Generator of scenarios in the format of config.txt.
+ *
+ *  Writes the number of groups, the number of tables, the number of waiters and of chefs (when there
+ *  are more than one) and, for each group, its arrival time (the
+ *  <tt>startTime</tt> of config.txt) and its eating time, both in microseconds, drawn from the chosen
+ *  distributions. The output may be fed to the simulation through a pipe (option -c -).
+ *
+ *  The scenario may instead be written compiled (see scenario.h), so that the simulation copies the times
+ *  into the shared region without parsing them, and an existing scenario file may be converted rather
+ *  than a new one generated.
+ *
+ *  Options:
+ *    \li -g groups  number of groups (default 1000)
+ *    \li -t tables  number of tables (default one for every 10 groups)
+ *    \li -w waiters  number of waiters (default 1)
+ *    \li -C chefs  number of chefs (default 1)
+ *    \li -a uniform|poisson|rush  arrival process over the horizon (default poisson): uniform arrivals,
+ *        a Poisson process, or a lunch rush where 70% of the groups arrive around the middle of the
+ *        horizon (normal, standard deviation of a tenth of the horizon) and the others uniformly
+ *    \li -T horizon  time span of the arrivals in microseconds (default 10000000)
+ *    \li -e const|uniform|exp|normal  distribution of the eating times (default exp): constant, uniform
+ *        between 0 and twice the mean, exponential, or normal with a standard deviation of a quarter of the mean
+ *    \li -E mean  mean eating time in microseconds (default 100000)
+ *    \li -r seed  seed of the random generator (default 1)
+ *    \li -o file  output file (default stdout)
+ *    \li -B  compiled output
+ *    \li -i file  scenario file (text or compiled, - for stdin) to be converted instead of generating one (the
+ *        other options but -o and -B are ignored).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <math.h>
+
+#include "scenario.h"
+
+/* arrival processes */
+#define  ARR_UNIFORM    0
+#define  ARR_POISSON    1
+#define  ARR_RUSH       2
+
+/* eating time distributions */
+#define  EAT_CONST      0
+#define  EAT_UNIFORM    1
+#define  EAT_EXP        2
+#define  EAT_NORMAL     3
+
+/** \brief fraction of the groups that arrive during the rush */
+#define  RUSHFRACTION   0.7
+
+/**
+ *  \brief uniform value in [0, 1).
+ */
+static double uniform (void)
+{
+    return random () / (RAND_MAX + 1.0);
+}
+
+/**
+ *  \brief exponential value.
+ *
+ *  \param mean mean of the distribution
+ */
+static double exponential (double mean)
+{
+    return -mean * log (1.0 - uniform ());
+}
+
+/**
+ *  \brief normal value (Box-Muller).
+ *
+ *  \param mean mean of the distribution
+ *  \param stddev standard deviation of the distribution
+ */
+static double normal (double mean, double stddev)
+{
+    return mean + stddev * sqrt (-2.0 * log (1.0 - uniform ())) * cos (2.0 * M_PI * uniform ());
+}
+
+/**
+ *  \brief converts a time to the range of config.txt.
+ *
+ *  \param t time in microseconds
+ */
+static int toTime (double t)
+{
+    if (t < 0.0) return 0;
+    if (t > INT_MAX) return INT_MAX;
+    return (int) t;
+}
+
+/**
+ *  \brief parses the name of a distribution.
+ *
+ *  \param arg option argument
+ *  \param names names of the distributions (NULL terminated)
+ *
+ *  \return position of the name, or -1 if it is unknown
+ */
+static int lookup (const char *arg, const char *names[])
+{
+    int n;
+
+    for (n = 0; names[n] != NULL; n++)
+        if (strcmp (arg, names[n]) == 0)
+            return n;
+    return -1;
+}
+
+/**
+ *  \brief writes a scenario in the format of config.txt.
+ */
+static void writeText (FILE *fp, const SCENARIO *sc, const int startTime[], const int eatTime[])
+{
+    int g;
+
+    fprintf (fp, "#ngroups\n%d\n#ntables\n%d\n", sc->nGroups, sc->nTables);
+    if (sc->nWaiters != 1)
+        fprintf (fp, "#nwaiters\n%d\n", sc->nWaiters);
+    if (sc->nChefs != 1)
+        fprintf (fp, "#nchefs\n%d\n", sc->nChefs);
+    if (sc->seedGiven)
+        fprintf (fp, "#seed\n%llu\n", sc->seed);
+    if (sc->policy != -1)
+        fprintf (fp, "#policy\n%s\n", policyName[sc->policy]);
+    fprintf (fp, "#startTime timeToEat\n");
+    for (g = 0; g < sc->nGroups; g++)
+        fprintf (fp, "%d %d\n", startTime[g], eatTime[g]);
+}
+
+/**
+ *  \brief writes a compiled scenario.
+ */
+static void writeBinary (FILE *fp, const SCENARIO *sc, const int startTime[], const int eatTime[])
+{
+    SCENARIO_HEADER hdr;
+
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, SCENMAGIC, sizeof (hdr.magic));
+    hdr.version = SCENVERSION;
+    hdr.nGroups = sc->nGroups;
+    hdr.nTables = sc->nTables;
+    hdr.nWaiters = sc->nWaiters;
+    hdr.nChefs = sc->nChefs;
+    hdr.policy = sc->policy;
+    hdr.seedGiven = sc->seedGiven;
+    hdr.seed = sc->seed;
+    fwrite (&hdr, sizeof (hdr), 1, fp);
+    fwrite (startTime, sizeof (int), (size_t) sc->nGroups, fp);
+    fwrite (eatTime, sizeof (int), (size_t) sc->nGroups, fp);
+}
+
+/**
+ *  \brief Main program.
+ */
+int main (int argc, char *argv[])
+{
+    static const char *arrName[] = {"uniform", "poisson", "rush", NULL};
+    static const char *eatName[] = {"const", "uniform", "exp", "normal", NULL};
+    long nGroups = 1000, nTables = 0, nWaiters = 1, nChefs = 1, g;
+    int arrival = ARR_POISSON, eating = EAT_EXP;
+    double horizon = 10000000.0, eatMean = 100000.0, clock = 0.0, start, eat;
+    unsigned int seed = 1;
+    char *tinp = "";
+    char *nFicIn = NULL;
+    bool binary = false;
+    FILE *fp = stdout;
+    SCENARIO sc = { .seedGiven = false, .policy = -1 };
+    int *startTime, *eatTime;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "g:t:w:C:a:T:e:E:r:o:Bi:")) != -1) {
+        switch (opt) {
+            case 'g': nGroups = strtol (optarg, &tinp, 0); break;
+            case 't': nTables = strtol (optarg, &tinp, 0); break;
+            case 'w': nWaiters = strtol (optarg, &tinp, 0); break;
+            case 'C': nChefs = strtol (optarg, &tinp, 0); break;
+            case 'a': if ((arrival = lookup (optarg, arrName)) == -1) tinp = "?"; break;
+            case 'T': horizon = strtod (optarg, &tinp); break;
+            case 'e': if ((eating = lookup (optarg, eatName)) == -1) tinp = "?"; break;
+            case 'E': eatMean = strtod (optarg, &tinp); break;
+            case 'r': seed = (unsigned int) strtoul (optarg, &tinp, 0); break;
+            case 'o':
+                if ((fp = fopen (optarg, "w")) == NULL) {
+                    perror ("error on opening the output file");
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'B': binary = true; break;
+            case 'i': nFicIn = optarg; break;
+            default: tinp = "?";
+        }
+        if (*tinp != '\0') {
+            fprintf (stderr, "USAGE: %s [-g groups] [-t tables] [-w waiters] [-C chefs] [-a uniform|poisson|rush] "
+                             "[-T horizon] [-e const|uniform|exp|normal] [-E mean] [-r seed] [-o file] [-B] "
+                             "[-i file|-]\n", argv[0]);
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    if (nFicIn != NULL) {                                                    /* conversion of a scenario */
+        if (scenarioOpen (nFicIn, &sc) == -1)
+            exit (EXIT_FAILURE);
+        if (((startTime = malloc ((size_t) sc.nGroups * sizeof (int))) == NULL) ||
+            ((eatTime = malloc ((size_t) sc.nGroups * sizeof (int))) == NULL)) {
+            perror ("error on allocating the times of the groups");
+            exit (EXIT_FAILURE);
+        }
+        if (scenarioLoad (&sc, startTime, eatTime) == -1)
+            exit (EXIT_FAILURE);
+        scenarioClose (&sc);
+    }
+    else {
+        if (nTables == 0)
+            nTables = (nGroups + 9) / 10;
+        if ((nGroups < 1) || (nGroups > INT_MAX) || (nTables < 1) || (nTables > INT_MAX) || (nWaiters < 1) ||
+            (nWaiters > INT_MAX) || (nChefs < 1) || (nChefs > INT_MAX) || (horizon < 0.0) ||
+            (eatMean < 0.0)) {
+            fprintf (stderr, "Wrong argument value!\n");
+            exit (EXIT_FAILURE);
+        }
+        sc.nGroups = (int) nGroups;
+        sc.nTables = (int) nTables;
+        sc.nWaiters = (int) nWaiters;
+        sc.nChefs = (int) nChefs;
+        if (((startTime = malloc ((size_t) nGroups * sizeof (int))) == NULL) ||
+            ((eatTime = malloc ((size_t) nGroups * sizeof (int))) == NULL)) {
+            perror ("error on allocating the times of the groups");
+            exit (EXIT_FAILURE);
+        }
+        srandom (seed);
+        for (g = 0; g < nGroups; g++) {
+            switch (arrival) {
+                case ARR_UNIFORM:
+                    start = horizon * uniform ();
+                    break;
+                case ARR_POISSON:
+                    clock += exponential (horizon / nGroups);
+                    start = clock;
+                    break;
+                default:
+                    start = (uniform () < RUSHFRACTION) ? normal (horizon / 2, horizon / 10) : horizon * uniform ();
+            }
+            switch (eating) {
+                case EAT_CONST:   eat = eatMean; break;
+                case EAT_UNIFORM: eat = 2 * eatMean * uniform (); break;
+                case EAT_EXP:     eat = exponential (eatMean); break;
+                default:          eat = normal (eatMean, eatMean / 4);
+            }
+            startTime[g] = toTime (start);
+            eatTime[g] = toTime (eat);
+        }
+    }
+
+    if (binary) writeBinary (fp, &sc, startTime, eatTime);
+    else writeText (fp, &sc, startTime, eatTime);
+    free (startTime);
+    free (eatTime);
+    if (ferror (fp) || (fclose (fp) == EOF)) {
+        perror ("error on writing the output file");
+        exit (EXIT_FAILURE);
+    }
+    return EXIT_SUCCESS;
+}
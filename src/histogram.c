@@ -0,0 +1,175 @@
+/**
+ *  \file histogram.c (implementation file)
+ *
+ *  \brief Latency histograms.
+ *
+ *  Defined operations:
+ *     \li recording of a value
+ *     \li computation of a percentile
+ *     \li printing of a summary line
+ *     \li merging of histograms into a file shared by several runs.
+ *
+ *  The file holds, for each histogram, a line <tt>hist name count sum max</tt>, followed by a line
+ *  <tt>bucket count</tt> for each non-empty bucket and by a line <tt>end</tt>; lines
+ *  starting with <tt>#</tt> are comments.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+#include "histogram.h"
+
+/* internal functions */
+
+static unsigned int bucketOf (unsigned long long v)
+{
+    unsigned int m, b;
+
+    if (v < HISTSUB)
+        return (unsigned int) v;
+    m = 63 - (unsigned int) __builtin_clzll (v);                                        /* v >= 2^m, bits 4 and up */
+    b = (m - 3) * HISTSUB + (unsigned int) ((v >> (m - 4)) & (HISTSUB - 1));
+    return (b < HISTBUCKETS) ? b : HISTBUCKETS - 1;
+}
+
+static unsigned long long lowestOf (unsigned int b)
+{
+    if (b < HISTSUB)
+        return b;
+    return (unsigned long long) (HISTSUB + b % HISTSUB) << (b / HISTSUB - 1);
+}
+
+/**
+ *  \brief Recording of a value.
+ *
+ *  \param h pointer to the histogram
+ *  \param v value
+ */
+void histRecord (HISTOGRAM *h, unsigned long long v)
+{
+    unsigned long long max = __atomic_load_n (&h->max, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add (&h->bucket[bucketOf (v)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&h->sum, v, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&h->count, 1, __ATOMIC_RELAXED);
+    while ((v > max) && !__atomic_compare_exchange_n (&h->max, &max, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/**
+ *  \brief Computation of a percentile.
+ *
+ *  \param h pointer to the histogram
+ *  \param p percentile (0 .. 100)
+ *
+ *  \return largest value of the bucket where the percentile lies (never above the largest value),
+ *          or 0 if the histogram is empty
+ */
+unsigned long long histPercentile (const HISTOGRAM *h, double p)
+{
+    unsigned long long rank, seen = 0, top;
+    unsigned int b;
+
+    if (h->count == 0)
+        return 0;
+    rank = (unsigned long long) (p / 100.0 * h->count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->count) rank = h->count;
+    for (b = 0; b < HISTBUCKETS - 1; b++) {
+        if ((seen += h->bucket[b]) >= rank)
+            break;
+    }
+    top = (b < HISTBUCKETS - 1) ? lowestOf (b + 1) - 1 : h->max;
+    return (top < h->max) ? top : h->max;
+}
+
+/**
+ *  \brief Printing of a summary line: number of values, mean, p50, p90, p99 and largest value.
+ *
+ *  \param fp stream where the line is printed
+ *  \param name name of the histogram
+ *  \param h pointer to the histogram
+ */
+void histPrint (FILE *fp, const char *name, const HISTOGRAM *h)
+{
+    fprintf (fp, "%-16s n=%llu mean=%.0f p50=%llu p90=%llu p99=%llu max=%llu (us)\n", name, h->count,
+             (h->count > 0) ? (double) h->sum / h->count : 0.0, histPercentile (h, 50.0),
+             histPercentile (h, 90.0), histPercentile (h, 99.0), h->max);
+}
+
+/**
+ *  \brief Merging of histograms into a file shared by several runs.
+ *
+ *  The histograms stored in the file, if any, are added to <tt>h</tt> and the sums are written back,
+ *  preceded by their summary lines (as comments). The file is locked meanwhile, so runs that end at
+ *  the same time do not lose each other's values.
+ *
+ *  \param nFic name of the file
+ *  \param name names of the histograms
+ *  \param h histograms (updated with the values stored in the file)
+ *  \param n number of histograms
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+int histMergeFile (const char *nFic, const char *name[], HISTOGRAM h[], unsigned int n)
+{
+    FILE *fp;
+    int fd;
+    char line[100], hName[40];
+    HISTOGRAM *cur = NULL;
+    unsigned long long count, sum, max;
+    unsigned int b, c, k;
+
+    if ((fd = open (nFic, O_RDWR | O_CREAT, 0644)) == -1)
+        return -1;
+    if ((flock (fd, LOCK_EX) == -1) || ((fp = fdopen (fd, "r+")) == NULL)) {
+        close (fd);
+        return -1;
+    }
+
+    /* adding the stored histograms */
+    while (fgets (line, sizeof (line), fp) != NULL) {
+        if (line[0] == '#')
+            continue;
+        if (sscanf (line, "hist %39s %llu %llu %llu", hName, &count, &sum, &max) == 4) {
+            for (k = 0; (k < n) && (strcmp (hName, name[k]) != 0); k++);
+            cur = (k < n) ? &h[k] : NULL;
+            if (cur != NULL) {
+                cur->count += count;
+                cur->sum += sum;
+                if (max > cur->max) cur->max = max;
+            }
+        }
+        else if (strncmp (line, "end", 3) == 0)
+            cur = NULL;
+        else if ((cur != NULL) && (sscanf (line, "%u %u", &b, &c) == 2) && (b < HISTBUCKETS))
+            cur->bucket[b] += c;
+    }
+
+    /* writing back the sums */
+    rewind (fp);
+    if (ftruncate (fd, 0) == -1) {
+        fclose (fp);
+        return -1;
+    }
+    for (k = 0; k < n; k++) {
+        fputs ("# ", fp);
+        histPrint (fp, name[k], &h[k]);
+    }
+    for (k = 0; k < n; k++) {
+        fprintf (fp, "hist %s %llu %llu %llu\n", name[k], h[k].count, h[k].sum, h[k].max);
+        for (b = 0; b < HISTBUCKETS; b++)
+            if (h[k].bucket[b] != 0)
+                fprintf (fp, "%u %u\n", b, h[k].bucket[b]);
+        fputs ("end\n", fp);
+    }
+    fflush (fp);
+    flock (fd, LOCK_UN);
+    return (fclose (fp) == EOF) ? -1 : 0;
+}
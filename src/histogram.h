@@ -0,0 +1,87 @@
+/**
+ *  \file histogram.h (interface file)
+ *
+ *  \brief Latency histograms.
+ *
+ *  Defined operations:
+ *     \li recording of a value
+ *     \li computation of a percentile
+ *     \li printing of a summary line
+ *     \li merging of histograms into a file shared by several runs.
+ *
+ *  Values (in microseconds) are counted in log-scaled buckets: values below HISTSUB have a bucket
+ *  of their own and every power of two above is split in HISTSUB buckets, so a percentile is
+ *  reported with a relative error below 1/HISTSUB. Recording takes a few atomic additions, so
+ *  histograms in shared memory may be updated by several entities at the same time.
+ */
+
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <stdio.h>
+
+/** \brief number of buckets per power of two */
+#define  HISTSUB          16
+/** \brief number of buckets (values from 2^47 microseconds on share the last one) */
+#define  HISTBUCKETS     720
+
+/**
+ *  \brief Definition of a histogram.
+ */
+typedef struct {
+    /** \brief number of values */
+    unsigned long long count;
+    /** \brief sum of the values */
+    unsigned long long sum;
+    /** \brief largest value */
+    unsigned long long max;
+    /** \brief number of values in each bucket */
+    unsigned int bucket[HISTBUCKETS];
+} HISTOGRAM;
+
+/**
+ *  \brief Recording of a value.
+ *
+ *  \param h pointer to the histogram
+ *  \param v value
+ */
+extern void histRecord (HISTOGRAM *h, unsigned long long v);
+
+/**
+ *  \brief Computation of a percentile.
+ *
+ *  \param h pointer to the histogram
+ *  \param p percentile (0 .. 100)
+ *
+ *  \return largest value of the bucket where the percentile lies (never above the largest value),
+ *          or 0 if the histogram is empty
+ */
+extern unsigned long long histPercentile (const HISTOGRAM *h, double p);
+
+/**
+ *  \brief Printing of a summary line: number of values, mean, p50, p90, p99 and largest value.
+ *
+ *  \param fp stream where the line is printed
+ *  \param name name of the histogram
+ *  \param h pointer to the histogram
+ */
+extern void histPrint (FILE *fp, const char *name, const HISTOGRAM *h);
+
+/**
+ *  \brief Merging of histograms into a file shared by several runs.
+ *
+ *  The histograms stored in the file, if any, are added to <tt>h</tt> and the sums are written back,
+ *  preceded by their summary lines (as comments). The file is locked meanwhile, so runs that end at
+ *  the same time do not lose each other's values.
+ *
+ *  \param nFic name of the file
+ *  \param name names of the histograms
+ *  \param h histograms (updated with the values stored in the file)
+ *  \param n number of histograms
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+extern int histMergeFile (const char *nFic, const char *name[], HISTOGRAM h[], unsigned int n);
+
+#endif /* HISTOGRAM_H_ */
@@ -0,0 +1,273 @@
+/**
+ *  \file logRender.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Offline renderer of binary trace files.
+ *
+ *  Converts a trace file written in LOG_TRACE mode into the text log written by <tt>saveState</tt>,
+ *  or into the filtered format produced by <tt>filter_log.awk</tt>, where an entity state that did
+ *  not change since the previous line is shown as a dot.
+ *
+ *  A delta file written in LOG_DELTA mode is replayed instead: its events are applied, line by line,
+ *  to the base state stored in the file, and every line rebuilt is rendered in the same way, so the
+ *  text log is the same that <tt>saveState</tt> would have written.
+ *
+ *  Upon execution, one parameter is requested:
+ *    \li name of the trace file (or of the delta file).
+ *
+ *  Options:
+ *    \li -d  filtered ("dots") format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "probConst.h"
+#include "probDataStruct.h"
+#include "logging.h"
+
+/**
+ *  \brief print one field of the filtered format.
+ *
+ *  \param size field width
+ *  \param val field value
+ *  \param prev value of the field in the previous line (NULL if it should not be compared)
+ */
+static void printField (int size, int val, int *prev)
+{
+    if ((prev != NULL) && (*prev == val)) {
+        printf ("%*s ", size, ".");
+    }
+    else printf ("%*d ", size, val);
+}
+
+/**
+ *  \brief print a state record in the filtered format.
+ *
+ *  \param rec pointer to the state record
+ *  \param prev pointer to the previous state record (NULL for the first one)
+ *  \param nChefs number of chefs
+ *  \param nWaiters number of waiters
+ *  \param nGroups number of groups
+ */
+static void printDots (LOG_RECORD *rec, LOG_RECORD *prev, int nChefs, int nWaiters, int nGroups)
+{
+    int nw = nChefs + nWaiters;
+    int g;
+
+    for (g = 0; g < nChefs; g++) {
+        printField (3, RECCHEFSTAT(rec)[g], prev ? &RECCHEFSTAT(prev)[g] : NULL);
+    }
+    for (g = 0; g < nWaiters; g++) {
+        printField ((nWaiters == 1) ? 2 : 3, RECWAITERSTAT(rec, nChefs)[g], prev ? &RECWAITERSTAT(prev, nChefs)[g] : NULL);
+    }
+    printField (2, rec->st.receptionistStat, prev ? (int *) &prev->st.receptionistStat : NULL);
+    for (g = 0; g < nGroups; g++) {
+        printField (3, RECGROUPSTAT(rec, nw)[g], prev ? &RECGROUPSTAT(prev, nw)[g] : NULL);
+    }
+    printField (4, rec->groupsWaiting, NULL);
+    for (g = 0; g < nGroups; g++) {
+        if (RECTABLE(rec, nw, nGroups)[g] != -1)
+            printField (3, RECTABLE(rec, nw, nGroups)[g], NULL);
+        else printf ("%3s ", ".");
+    }
+    printf ("\n");
+}
+
+/**
+ *  \brief print the title and the column header in the filtered format.
+ *
+ *  \param nChefs number of chefs
+ *  \param nWaiters number of waiters
+ *  \param nGroups number of groups
+ */
+static void printDotsTitle (int nChefs, int nWaiters, int nGroups)
+{
+    int g;
+
+    printf ("%31cRestaurant - Description of the internal state\n\n", ' ');
+    if (nChefs == 1)
+        printf ("%3s ", "CH");
+    else for (g = 0; g < nChefs; g++) {
+        printf ("C%02d ", g);
+    }
+    if (nWaiters == 1)
+        printf ("%2s ", "WT");
+    else for (g = 0; g < nWaiters; g++) {
+        printf ("W%02d ", g);
+    }
+    printf ("%2s ", "RC");
+    for (g = 0; g < nGroups; g++) {
+        printf ("G%02d ", g);
+    }
+    printf ("%4s ", "gWT");
+    for (g = 0; g < nGroups; g++) {
+        printf ("T%02d ", g);
+    }
+    printf ("\n");
+}
+
+/**
+ *  \brief replays a delta file and renders every line rebuilt.
+ *
+ *  \param hdr mapping of the delta file
+ *  \param size size in bytes of the file
+ *  \param name name of the file
+ *  \param dots filtered format
+ *
+ *  \return EXIT_SUCCESS or, if the file is corrupted, EXIT_FAILURE
+ */
+static int replayDelta (DELTA_HEADER *hdr, off_t size, const char *name, bool dots)
+{
+    int32_t *col;                                                                          /* columns of the state */
+    DELTA_EVENT *ev;                                                                           /* current event */
+    LOG_RECORD *rec, *prev, *tmp;                                                      /* current and previous state */
+    unsigned int nw, e, line;
+
+    if (hdr->version != DELTAVERSION) {
+        fprintf (stderr, "%s is not a delta file of version %d!\n", name, DELTAVERSION);
+        return EXIT_FAILURE;
+    }
+    nw = hdr->nChefs + hdr->nWaiters;
+    if ((hdr->nChefs < 1) || (hdr->nWaiters < 1) || (hdr->nColumns != nw + 2 + 2 * hdr->nGroups) ||
+        (size < (off_t) (sizeof (DELTA_HEADER) + 2 * (size_t) hdr->nColumns * sizeof (int32_t) +
+                         (size_t) hdr->nEvents * sizeof (DELTA_EVENT)))) {
+        fprintf (stderr, "%s is corrupted!\n", name);
+        return EXIT_FAILURE;
+    }
+    if (hdr->lost > 0) {
+        fprintf (stderr, "%u events did not fit in %s: the last lines are left out\n",
+                 hdr->lost, name);
+    }
+
+    if (((col = malloc (hdr->nColumns * sizeof (int32_t))) == NULL) ||
+        ((rec = malloc (LOGRECSIZE (nw, hdr->nGroups))) == NULL) ||
+        ((prev = malloc (LOGRECSIZE (nw, hdr->nGroups))) == NULL)) {
+        perror ("error on allocating the state records");
+        return EXIT_FAILURE;
+    }
+    memcpy (col, DELTABASE (hdr), hdr->nColumns * sizeof (int32_t));
+
+    if (dots)
+        printDotsTitle (hdr->nChefs, hdr->nWaiters, (int) hdr->nGroups);
+    else printTitle (stdout, hdr->nChefs, hdr->nWaiters, (int) hdr->nGroups);
+    ev = DELTAEVENT (hdr);
+    for (e = 0; e < hdr->nEvents; ) {
+        line = ev[e].line;                                           /* the events of a line are consecutive */
+        for (; (e < hdr->nEvents) && (ev[e].line == line); e++) {
+            if (ev[e].column == DELTANOCHANGE) continue;
+            if ((ev[e].column >= hdr->nColumns) || (col[ev[e].column] != ev[e].oldVal)) {
+                fprintf (stderr, "%s is corrupted (event %u)!\n", name, e);
+                return EXIT_FAILURE;
+            }
+            col[ev[e].column] = ev[e].newVal;
+        }
+        unpackColumns (hdr, col, rec);
+        if (dots)
+            printDots (rec, (line == 0) ? NULL : prev, hdr->nChefs, hdr->nWaiters, (int) hdr->nGroups);
+        else printState (stdout, rec, hdr->nChefs, hdr->nWaiters, (int) hdr->nGroups);
+        tmp = prev; prev = rec; rec = tmp;
+    }
+    free (col);
+    free (rec);
+    free (prev);
+    return EXIT_SUCCESS;
+}
+
+/**
+ *  \brief Main program.
+ *
+ *  Maps the trace file, checks its header and renders all the valid records in a single scan.
+ */
+int main (int argc, char *argv[])
+{
+    int fd;                                                                                       /* file descriptor */
+    struct stat st;                                                                                  /* file status */
+    TRACE_HEADER *hdr;                                                                   /* mapping of the trace file */
+    unsigned char *pRec;                                                                  /* current packed record */
+    LOG_RECORD *rec, *prev, *tmp;                                                      /* current and previous state */
+    bool dots = false;                                                                   /* filtered format flag */
+    unsigned int r;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "d")) != -1) {
+        switch (opt) {
+            case 'd':
+                dots = true;
+                break;
+            default:
+                fprintf (stderr, "USAGE: %s [-d] tracefile|deltafile\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc-1) {
+        fprintf (stderr, "USAGE: %s [-d] tracefile|deltafile\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if ((fd = open (argv[optind], O_RDONLY)) == -1) {
+        perror ("error on opening trace file");
+        return EXIT_FAILURE;
+    }
+    if (fstat (fd, &st) == -1) {
+        perror ("error on reading the status of trace file");
+        return EXIT_FAILURE;
+    }
+    if (st.st_size < (off_t) sizeof (TRACE_HEADER)) {
+        fprintf (stderr, "%s is not a trace file!\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if ((hdr = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        perror ("error on mapping trace file");
+        return EXIT_FAILURE;
+    }
+    close (fd);
+
+    if ((st.st_size >= (off_t) sizeof (DELTA_HEADER)) && (memcmp (hdr->magic, DELTAMAGIC, sizeof (hdr->magic)) == 0)) {
+        opt = replayDelta ((DELTA_HEADER *) hdr, st.st_size, argv[optind], dots);
+        munmap (hdr, (size_t) st.st_size);
+        return opt;
+    }
+    if ((memcmp (hdr->magic, TRACEMAGIC, sizeof (hdr->magic)) != 0) || (hdr->version != TRACEVERSION)) {
+        fprintf (stderr, "%s is not a trace file of version %d!\n", argv[optind], TRACEVERSION);
+        return EXIT_FAILURE;
+    }
+    if ((hdr->nChefs < 1) || (hdr->nWaiters < 1) ||
+        (hdr->recSize != hdr->nChefs + hdr->nWaiters + 1 + hdr->nGroups + 2 + hdr->nGroups * hdr->tableBytes) ||
+        (st.st_size < (off_t) (sizeof (TRACE_HEADER) + (size_t) hdr->nRecords * hdr->recSize))) {
+        fprintf (stderr, "%s is corrupted!\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    if (((rec = malloc (LOGRECSIZE (hdr->nChefs + hdr->nWaiters, hdr->nGroups))) == NULL) ||
+        ((prev = malloc (LOGRECSIZE (hdr->nChefs + hdr->nWaiters, hdr->nGroups))) == NULL)) {
+        perror ("error on allocating the state records");
+        return EXIT_FAILURE;
+    }
+
+    if (dots)
+        printDotsTitle (hdr->nChefs, hdr->nWaiters, (int) hdr->nGroups);
+    else printTitle (stdout, hdr->nChefs, hdr->nWaiters, (int) hdr->nGroups);
+    pRec = (unsigned char *) (hdr + 1);
+    for (r = 0; r < hdr->nRecords; r++, pRec += hdr->recSize) {
+        unpackState (hdr, pRec, rec);
+        if (dots)
+            printDots (rec, (r == 0) ? NULL : prev, hdr->nChefs, hdr->nWaiters, (int) hdr->nGroups);
+        else printState (stdout, rec, hdr->nChefs, hdr->nWaiters, (int) hdr->nGroups);
+        tmp = prev; prev = rec; rec = tmp;
+    }
+    free (rec);
+    free (prev);
+
+    munmap (hdr, (size_t) st.st_size);
+
+    return EXIT_SUCCESS;
+}
@@ -7,7 +7,15 @@
  *
  *  Defined operations:
  *     \li file initialization
- *     \li writing the present full state as a single line at the end of the file.
+ *     \li binary trace file initialization and completion
+ *     \li binary delta file initialization (completed as a trace file)
+ *     \li binding to the shared buffer of state records
+ *     \li writing the present full state as a single line at the end of the file
+ *     \li writing the stamped state records held by the caller (LOG_DEFER mode)
+ *     \li draining the buffered state records into the file
+ *     \li sorting the lines written in LOG_DEFER mode
+ *     \li decoding and printing of trace records
+ *     \li decoding of the columns rebuilt from a delta file.
  *
  *  \author Nuno Lau - December 2023
  */
@@ -16,13 +24,67 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <errno.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 
 #include "probConst.h"
 #include "probDataStruct.h"
+#include "logging.h"
+
+/** \brief shared buffer of state records (NULL until attachLog is called) */
+static LOG_BUFFER *logBuf = NULL;
+
+/** \brief mapping of the binary trace file (NULL if not in LOG_TRACE mode) */
+static TRACE_HEADER *trace = NULL;
+
+/** \brief size of the mapping of the binary trace file */
+static size_t traceSize;
+
+/** \brief mapping of the binary delta file (NULL if not in LOG_DELTA mode) */
+static DELTA_HEADER *delta = NULL;
+
+/** \brief size of the mapping of the binary delta file */
+static size_t deltaSize;
+
+/** \brief state record used to format lines in LOG_TEXT mode (allocated on first use) */
+static LOG_RECORD *textRec = NULL;
+
+#ifdef THREADED
+#define LOGLOCAL __thread
+#else
+#define LOGLOCAL
+#endif
+
+/** \brief descriptor of the logging file, opened for appending (-1 if not in LOG_DEFER mode) */
+static int deferFd = -1;
+
+/** \brief stamped state records held by the caller in LOG_DEFER mode (allocated on first use) */
+static LOGLOCAL LOG_RECORD *deferRec = NULL;
+
+/** \brief sequence number of the state of each record held by the caller */
+static LOGLOCAL unsigned int deferSeq[DEFERRECORDS];
+
+/** \brief number of records held by the caller */
+static LOGLOCAL unsigned int nDefer = 0;
+
+/** \brief width of the stamp that prefixes the lines written in LOG_DEFER mode (until sortLog removes it) */
+#define  STAMPWIDTH       9
+
+/** \brief line of the logging file to be sorted by sortLog */
+typedef struct {
+    /** \brief sequence number of the state */
+    unsigned int seq;
+    /** \brief position of the line in the file */
+    unsigned int pos;
+    /** \brief text of the line, stamp excluded */
+    char *text;
+} STAMPED_LINE;
 
 /* internal functions */
 
@@ -60,26 +122,242 @@ static void closeLog(FILE *fic)
     }
 }
 
-static void printHeader(FILE *fic, FULL_STAT *p_fSt)
+static void printWorkers(FILE *fic, const char *name, int n)
+{
+    int w;
+
+    if (n == 1) {
+        fprintf(fic,"%3s",name);
+        return;
+    }
+    for(w=0; w < n; w++) {
+        fprintf(fic," %c%02d",name[0],w);
+    }
+}
+
+static void printHeader(FILE *fic, int nChefs, int nWaiters, int nGroups)
 {
-    fprintf(fic,"%3s","CH");
-    fprintf(fic,"%3s","WT");
+    printWorkers(fic,"CH",nChefs);
+    printWorkers(fic,"WT",nWaiters);
     fprintf(fic,"%3s","RC");
     fprintf(fic," ");
     int g;
-    for(g=0; g < p_fSt->nGroups; g++) {
+    for(g=0; g < nGroups; g++) {
         fprintf(fic," %s%02d","G",g);
     }
 
     fprintf(fic,"%5s","gWT");
 
-    for(g=0; g < p_fSt->nGroups; g++) {
+    for(g=0; g < nGroups; g++) {
         fprintf(fic," %s%02d","T",g);
     }
 
     fprintf(fic,"\n");
 }
 
+static void fillRecord(LOG_RECORD *rec, FULL_STAT *p_fSt)
+{
+    int nw = p_fSt->nChefs + p_fSt->nWaiters;
+
+    rec->st = p_fSt->st;
+    rec->groupsWaiting = p_fSt->groupsWaiting;
+    memcpy(RECCHEFSTAT(rec), CHEFSTAT(p_fSt), p_fSt->nChefs * sizeof(int));
+    memcpy(RECWAITERSTAT(rec, p_fSt->nChefs), WAITERSTAT(p_fSt), p_fSt->nWaiters * sizeof(int));
+    memcpy(RECGROUPSTAT(rec, nw), GROUPSTAT(p_fSt), p_fSt->nGroups * sizeof(int));
+    memcpy(RECTABLE(rec, nw, p_fSt->nGroups), ASSIGNEDTABLE(p_fSt), p_fSt->nGroups * sizeof(int));
+}
+
+static void pushRecord(FULL_STAT *p_fSt)
+{
+    unsigned int pos, slot;
+
+    /* reserve a slot and wait for the drain if the ring is full */
+    pos = __atomic_fetch_add(&logBuf->head, 1, __ATOMIC_RELAXED);
+    while (pos - __atomic_load_n(&logBuf->tail, __ATOMIC_ACQUIRE) >= LOGRINGSIZE) {
+        usleep(LOGDRAINPERIOD/10);
+    }
+
+    slot = pos % LOGRINGSIZE;
+    fillRecord(LOGREC(logBuf, slot), p_fSt);
+    __atomic_store_n(&logBuf->ready[slot], pos+1, __ATOMIC_RELEASE);
+}
+
+static LOG_RECORD *deferRecord(FULL_STAT *p_fSt, unsigned int k)
+{
+    return (LOG_RECORD *) ((char *) deferRec + k * LOGRECSIZE(p_fSt->nChefs + p_fSt->nWaiters, p_fSt->nGroups));
+}
+
+static void pushDefer(FULL_STAT *p_fSt)
+{
+    if ((deferRec == NULL) &&
+        ((deferRec = malloc(DEFERRECORDS * LOGRECSIZE(p_fSt->nChefs + p_fSt->nWaiters, p_fSt->nGroups))) == NULL)) {
+        perror ("error on allocating the stamped state records");
+        exit (EXIT_FAILURE);
+    }
+
+    /* within an update the sequence number is odd and unique, so it orders the records of all entities */
+    deferSeq[nDefer] = __atomic_load_n(&p_fSt->seq, __ATOMIC_RELAXED);
+    fillRecord(deferRecord(p_fSt, nDefer), p_fSt);
+    nDefer += 1;
+}
+
+static void writeDefer(FULL_STAT *p_fSt)
+{
+    FILE *mem;                                                                         /* stream of the lines */
+    char *buf = NULL;
+    size_t len = 0, done;
+    ssize_t n;
+    unsigned int k;
+
+    if ((mem = open_memstream(&buf, &len)) == NULL) {
+        perror ("error on formatting the stamped state records");
+        exit (EXIT_FAILURE);
+    }
+    for(k=0; k < nDefer; k++) {
+        fprintf(mem,"%08x ",deferSeq[k]);
+        printState(mem, deferRecord(p_fSt, k), p_fSt->nChefs, p_fSt->nWaiters, p_fSt->nGroups);
+    }
+    if (fclose(mem) == EOF) {
+        perror ("error on formatting the stamped state records");
+        exit (EXIT_FAILURE);
+    }
+    nDefer = 0;
+
+    /* a single append, so the lines of different entities are never mixed up */
+    for(done=0; done < len; done += (size_t) n) {
+        if ((n = write(deferFd, buf + done, len - done)) == -1) {
+            if (errno == EINTR) {
+                n = 0;
+                continue;
+            }
+            perror ("error on writing to log file");
+            exit (EXIT_FAILURE);
+        }
+    }
+    free(buf);
+}
+
+static int cmpStamped(const void *a, const void *b)
+{
+    const STAMPED_LINE *la = a, *lb = b;
+
+    if (la->seq != lb->seq) {
+        return (la->seq < lb->seq) ? -1 : 1;
+    }
+    return (la->pos < lb->pos) ? -1 : (la->pos > lb->pos);
+}
+
+static bool isStamped(const char *line)
+{
+    return (strspn(line, "0123456789abcdef") == STAMPWIDTH-1) && (line[STAMPWIDTH-1] == ' ');
+}
+
+static void *mapFile(char nFic[], size_t *size)
+{
+    int fd;                                                                                       /* file descriptor */
+    struct stat st;                                                                                  /* file status */
+    void *add;
+
+    if ((fd = open (nFic, O_RDWR)) == -1) {
+        perror ("error on opening trace file");
+        exit (EXIT_FAILURE);
+    }
+    if (fstat (fd, &st) == -1) {
+        perror ("error on reading the status of trace file");
+        exit (EXIT_FAILURE);
+    }
+    *size = (size_t) st.st_size;
+    if ((add = mmap (NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        perror ("error on mapping trace file");
+        exit (EXIT_FAILURE);
+    }
+    close (fd);
+    return add;
+}
+
+static void pushTrace(FULL_STAT *p_fSt)
+{
+    unsigned int pos;
+    unsigned char *p;
+    int g, t, b;
+
+    pos = __atomic_fetch_add(&trace->nRecords, 1, __ATOMIC_RELAXED);
+    if (pos >= trace->capacity) {
+        __atomic_fetch_add(&trace->lost, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    p = (unsigned char *) (trace + 1) + (size_t) pos * trace->recSize;
+    for(g=0; g < p_fSt->nChefs; g++) {
+        *p++ = (unsigned char) CHEFSTAT(p_fSt)[g];
+    }
+    for(g=0; g < p_fSt->nWaiters; g++) {
+        *p++ = (unsigned char) WAITERSTAT(p_fSt)[g];
+    }
+    *p++ = (unsigned char) p_fSt->st.receptionistStat;
+    for(g=0; g < p_fSt->nGroups; g++) {
+        *p++ = (unsigned char) GROUPSTAT(p_fSt)[g];
+    }
+    *p++ = (unsigned char) (p_fSt->groupsWaiting & 0xff);
+    *p++ = (unsigned char) ((p_fSt->groupsWaiting >> 8) & 0xff);
+    for(g=0; g < p_fSt->nGroups; g++) {
+        t = ASSIGNEDTABLE(p_fSt)[g];
+        for(b=0; b < trace->tableBytes; b++) {
+            *p++ = (unsigned char) ((t >> (8*b)) & 0xff);
+        }
+    }
+}
+
+static void pushEvent(uint32_t line, uint32_t column, int32_t oldVal, int32_t newVal)
+{
+    DELTA_EVENT *ev;
+
+    if (delta->nEvents >= delta->capacity) {
+        delta->lost += 1;
+        return;
+    }
+    ev = &DELTAEVENT(delta)[delta->nEvents++];
+    ev->line = line;
+    ev->column = column;
+    ev->oldVal = oldVal;
+    ev->newVal = newVal;
+}
+
+static uint32_t diffColumns(uint32_t line, uint32_t first, const int *val, int n)
+{
+    int32_t *shadow = DELTASHADOW(delta) + first;
+    uint32_t changed = 0;
+    int c;
+
+    for(c=0; c < n; c++) {
+        if (shadow[c] != val[c]) {
+            pushEvent(line, first + (uint32_t) c, shadow[c], val[c]);
+            shadow[c] = val[c];
+            changed += 1;
+        }
+    }
+    return changed;
+}
+
+static void pushDelta(FULL_STAT *p_fSt)
+{
+    int nw = p_fSt->nChefs + p_fSt->nWaiters;
+    int recept = (int) p_fSt->st.receptionistStat;
+    uint32_t line, changed;
+
+    /* the callers hold the state lock, so the lines and their events are appended in order */
+    line = delta->nLines++;
+    changed = diffColumns(line, 0, (const int *) CHEFSTAT(p_fSt), p_fSt->nChefs);
+    changed += diffColumns(line, p_fSt->nChefs, (const int *) WAITERSTAT(p_fSt), p_fSt->nWaiters);
+    changed += diffColumns(line, nw, &recept, 1);
+    changed += diffColumns(line, nw + 1, (const int *) GROUPSTAT(p_fSt), p_fSt->nGroups);
+    changed += diffColumns(line, nw + 1 + p_fSt->nGroups, &p_fSt->groupsWaiting, 1);
+    changed += diffColumns(line, nw + 2 + p_fSt->nGroups, ASSIGNEDTABLE(p_fSt), p_fSt->nGroups);
+    if (changed == 0) {
+        pushEvent(line, DELTANOCHANGE, 0, 0);
+    }
+}
+
 /* external functions */
 
 /**
@@ -100,22 +378,221 @@ void createLog (char nFic[], FULL_STAT *p_fSt)
 
     fic = openLog(nFic,"w");
 
-    /* title line + blank line */
-
-    fprintf (fic, "%31cRestaurant - Description of the internal state\n\n", ' ');
-    printHeader(fic, p_fSt);
+    printTitle (fic, p_fSt->nChefs, p_fSt->nWaiters, p_fSt->nGroups);
 
     closeLog(fic);
 }
 
+/**
+ *  \brief Binary trace file initialization.
+ *
+ *  The function creates the trace file, writes its header and reserves room for <tt>capacity</tt> records.
+ *
+ *  \param nFic name of the trace file
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ *  \param capacity number of records reserved
+ */
+void createTrace (char nFic[], FULL_STAT *p_fSt, unsigned int capacity)
+{
+    int fd;                                                                                       /* file descriptor */
+    TRACE_HEADER hdr;                                                                          /* trace file header */
+
+    if ((nFic == NULL) || (strlen (nFic) == 0)) {
+        fprintf (stderr, "A trace file name is required in trace mode!\n");
+        exit (EXIT_FAILURE);
+    }
+    if ((p_fSt->nTables >= 0xffff) || (p_fSt->nGroups > 0xffff) || (p_fSt->nChefs > 0xffff) ||
+        (p_fSt->nWaiters > 0xffff)) {
+        fprintf (stderr, "Too many tables, groups or workers for the trace format!\n");
+        exit (EXIT_FAILURE);
+    }
+
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, TRACEMAGIC, sizeof (hdr.magic));
+    hdr.version = TRACEVERSION;
+    hdr.numTables = (uint16_t) p_fSt->nTables;
+    hdr.nChefs = (uint16_t) p_fSt->nChefs;
+    hdr.nWaiters = (uint16_t) p_fSt->nWaiters;
+    hdr.nGroups = (uint32_t) p_fSt->nGroups;
+    hdr.tableBytes = (p_fSt->nTables < 0xff) ? 1 : 2;
+    hdr.recSize = hdr.nChefs + hdr.nWaiters + 1 + hdr.nGroups + 2 + hdr.nGroups * hdr.tableBytes;
+    hdr.capacity = capacity;
+
+    if ((fd = open (nFic, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1) {
+        perror ("error on opening trace file");
+        exit (EXIT_FAILURE);
+    }
+    if ((write (fd, &hdr, sizeof (hdr)) != sizeof (hdr)) ||
+        (ftruncate (fd, sizeof (hdr) + (off_t) capacity * hdr.recSize) == -1)) {
+        perror ("error on initializing trace file");
+        exit (EXIT_FAILURE);
+    }
+    close (fd);
+}
+
+/**
+ *  \brief Binary delta file initialization.
+ *
+ *  The function creates the delta file, writes its header and the present state as the base and
+ *  reserves room for <tt>capacity</tt> events. It is completed by <tt>closeTrace</tt>.
+ *
+ *  \param nFic name of the delta file
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ *  \param capacity number of events reserved
+ */
+void createDelta (char nFic[], FULL_STAT *p_fSt, unsigned int capacity)
+{
+    int fd;                                                                                       /* file descriptor */
+    DELTA_HEADER hdr;                                                                          /* delta file header */
+    int32_t *col;                                                                         /* columns of the state */
+    size_t colSize;
+    int nw = p_fSt->nChefs + p_fSt->nWaiters;
+
+    if ((nFic == NULL) || (strlen (nFic) == 0)) {
+        fprintf (stderr, "A delta file name is required in delta mode!\n");
+        exit (EXIT_FAILURE);
+    }
+    if ((p_fSt->nTables > 0xffff) || (p_fSt->nChefs > 0xffff) || (p_fSt->nWaiters > 0xffff)) {
+        fprintf (stderr, "Too many tables or workers for the delta format!\n");
+        exit (EXIT_FAILURE);
+    }
+
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, DELTAMAGIC, sizeof (hdr.magic));
+    hdr.version = DELTAVERSION;
+    hdr.numTables = (uint16_t) p_fSt->nTables;
+    hdr.nChefs = (uint16_t) p_fSt->nChefs;
+    hdr.nWaiters = (uint16_t) p_fSt->nWaiters;
+    hdr.nGroups = (uint32_t) p_fSt->nGroups;
+    hdr.nColumns = (uint32_t) (nw + 2 + 2 * p_fSt->nGroups);
+    hdr.capacity = capacity;
+
+    /* the base is the state the first line is compared with */
+    colSize = hdr.nColumns * sizeof (int32_t);
+    if ((col = malloc (colSize)) == NULL) {
+        perror ("error on allocating the columns of the state");
+        exit (EXIT_FAILURE);
+    }
+    memcpy (col, CHEFSTAT(p_fSt), p_fSt->nChefs * sizeof (int32_t));
+    memcpy (col + p_fSt->nChefs, WAITERSTAT(p_fSt), p_fSt->nWaiters * sizeof (int32_t));
+    col[nw] = (int32_t) p_fSt->st.receptionistStat;
+    memcpy (col + nw + 1, GROUPSTAT(p_fSt), p_fSt->nGroups * sizeof (int32_t));
+    col[nw + 1 + p_fSt->nGroups] = p_fSt->groupsWaiting;
+    memcpy (col + nw + 2 + p_fSt->nGroups, ASSIGNEDTABLE(p_fSt), p_fSt->nGroups * sizeof (int32_t));
+
+    if ((fd = open (nFic, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1) {
+        perror ("error on opening delta file");
+        exit (EXIT_FAILURE);
+    }
+    if ((write (fd, &hdr, sizeof (hdr)) != sizeof (hdr)) || (write (fd, col, colSize) != (ssize_t) colSize) ||
+        (write (fd, col, colSize) != (ssize_t) colSize) ||
+        (ftruncate (fd, sizeof (hdr) + 2 * (off_t) colSize + (off_t) capacity * sizeof (DELTA_EVENT)) == -1)) {
+        perror ("error on initializing delta file");
+        exit (EXIT_FAILURE);
+    }
+    close (fd);
+    free (col);
+}
+
+/**
+ *  \brief Binary trace file completion.
+ *
+ *  The function unmaps the trace file and cuts off the unused records.
+ *  Records that did not fit in the file are reported on stderr.
+ *  A delta file is completed in the same way.
+ *
+ *  \param nFic name of the trace file
+ */
+void closeTrace (char nFic[])
+{
+    off_t size;                                                                          /* size of the used part */
+
+    if (delta != NULL) {
+        if (delta->lost > 0) {
+            fprintf (stderr, "%u events did not fit in delta file %s\n", delta->lost, nFic);
+        }
+        size = (off_t) ((char *) &DELTAEVENT(delta)[delta->nEvents] - (char *) delta);
+        munmap (delta, deltaSize);
+        delta = NULL;
+        if (truncate (nFic, size) == -1) {
+            perror ("error on truncating delta file");
+            exit (EXIT_FAILURE);
+        }
+    }
+    if (trace == NULL) {
+        return;
+    }
+
+    if (trace->nRecords > trace->capacity) {
+        trace->nRecords = trace->capacity;
+    }
+    if (trace->lost > 0) {
+        fprintf (stderr, "%u records did not fit in trace file %s\n", trace->lost, nFic);
+    }
+    size = sizeof (TRACE_HEADER) + (off_t) trace->nRecords * trace->recSize;
+
+    munmap (trace, traceSize);
+    trace = NULL;
+    if (truncate (nFic, size) == -1) {
+        perror ("error on truncating trace file");
+        exit (EXIT_FAILURE);
+    }
+}
+
+/**
+ *  \brief Binding to the shared buffer of state records.
+ *
+ *  Must be called by every process after mapping the shared region. When the buffer mode is
+ *  LOG_RING, <tt>saveState</tt> appends records to the buffer instead of writing to the file.
+ *  When it is LOG_TRACE, the trace file previously created by <tt>createTrace</tt> is mapped
+ *  and <tt>saveState</tt> appends packed records to it (once per process, in the threaded build the
+ *  generator maps it before the entities are started). When it is LOG_DELTA, the delta file previously
+ *  created by <tt>createDelta</tt> is mapped in the same way and <tt>saveState</tt> appends the changes of
+ *  the state to it. When it is LOG_DEFER, the logging file is
+ *  opened for appending and <tt>saveState</tt> holds stamped records until <tt>flushState</tt>.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_lb pointer to the location where the shared log buffer is stored
+ */
+void attachLog (char nFic[], LOG_BUFFER *p_lb)
+{
+    if (logBuf == p_lb) {                                     /* already bound (once per process) */
+        return;
+    }
+    logBuf = p_lb;
+    if (logBuf->mode == LOG_TRACE) {
+        trace = mapFile (nFic, &traceSize);
+    }
+    else if (logBuf->mode == LOG_DELTA) {
+        delta = mapFile (nFic, &deltaSize);
+    }
+    else if (logBuf->mode == LOG_DEFER) {
+        if ((nFic == NULL) || (strlen (nFic) == 0)) {
+            fprintf (stderr, "A logging file name is required in defer mode!\n");
+            exit (EXIT_FAILURE);
+        }
+        if ((deferFd = open (nFic, O_WRONLY | O_APPEND)) == -1) {
+            perror ("error on opening log file");
+            exit (EXIT_FAILURE);
+        }
+    }
+}
+
 /**
  *  \brief Writing the present full state as a single line at the end of the file.
  *
  *  If <tt>nFic</tt> is a null pointer or a null string, the lines are written to stdout
  *
+ *  In LOG_RING mode the state is only copied to the shared buffer; the line is written
+ *  later by <tt>drainLog</tt>. In LOG_DEFER mode the state is only copied and stamped with its
+ *  sequence number (so the function must be called within an update); the line is written by
+ *  <tt>flushState</tt> once the caller has released the state lock. In LOG_DELTA mode only the columns
+ *  that differ from those of the previous line are appended, as events, to the delta file (which
+ *  requires the caller to hold the state lock); the lines are rebuilt by logRender.
+ *
  *  The following layout is obeyed for the full state in a single line
- *    \li chef state
- *    \li waiter state 
+ *    \li state of each chef
+ *    \li state of each waiter 
  *    \li receptioninst state 
  *    \li groups state 
  *    \li table assigned to each group
@@ -127,22 +604,211 @@ void saveState (char nFic[], FULL_STAT *p_fSt)
 {
     FILE *fic;                                                                                      /* file descriptor */
 
+    if ((logBuf != NULL) && (logBuf->mode == LOG_RING)) {
+        pushRecord(p_fSt);
+        return;
+    }
+    if (trace != NULL) {
+        pushTrace(p_fSt);
+        return;
+    }
+    if (delta != NULL) {
+        pushDelta(p_fSt);
+        return;
+    }
+    if (deferFd != -1) {
+        if (nDefer == DEFERRECORDS) {                     /* no room left: the held records are written now */
+            writeDefer(p_fSt);
+        }
+        pushDefer(p_fSt);
+        return;
+    }
+
+    fic = openLog(nFic,"a");
+
+    if ((textRec == NULL) &&
+        ((textRec = malloc(LOGRECSIZE(p_fSt->nChefs + p_fSt->nWaiters, p_fSt->nGroups))) == NULL)) {
+        perror ("error on allocating a state record");
+        exit (EXIT_FAILURE);
+    }
+    fillRecord(textRec, p_fSt);
+    printState(fic, textRec, p_fSt->nChefs, p_fSt->nWaiters, p_fSt->nGroups);
+
+    closeLog(fic);
+}
+
+/**
+ *  \brief Writing the stamped state records held by the caller (LOG_DEFER mode).
+ *
+ *  Must be called after releasing the state lock by every caller of <tt>saveState</tt>; in any other
+ *  mode, or if no records are held, it does nothing. The lines are appended to the file, each
+ *  prefixed by its stamp, in a single write.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ */
+void flushState (char nFic[], FULL_STAT *p_fSt)
+{
+    if ((deferFd != -1) && (nDefer > 0)) {
+        writeDefer(p_fSt);
+    }
+}
+
+/**
+ *  \brief Writing all the state records published in the shared buffer, in the order they were saved.
+ *
+ *  The layout of each line is the same used by <tt>saveState</tt> in LOG_TEXT mode.
+ *  Only one process (the drain) may call this function.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ */
+void drainLog (char nFic[], FULL_STAT *p_fSt)
+{
+    FILE *fic;                                                                                      /* file descriptor */
+    unsigned int pos, slot;
+
+    if (logBuf == NULL) {
+        return;
+    }
+
+    pos = logBuf->tail;
+    slot = pos % LOGRINGSIZE;
+    if (__atomic_load_n(&logBuf->ready[slot], __ATOMIC_ACQUIRE) != pos+1) {
+        return;                                                                              /* nothing published */
+    }
+
     fic = openLog(nFic,"a");
 
-    fprintf(fic,"%3d",p_fSt->st.chefStat);
-    fprintf(fic,"%3d",p_fSt->st.waiterStat);
-    fprintf(fic,"%3d",p_fSt->st.receptionistStat);
-    fprintf(fic," ");
+    while (__atomic_load_n(&logBuf->ready[slot], __ATOMIC_ACQUIRE) == pos+1) {
+        printState(fic, LOGREC(logBuf, slot), p_fSt->nChefs, p_fSt->nWaiters, p_fSt->nGroups);
+        pos++;
+        slot = pos % LOGRINGSIZE;
+        __atomic_store_n(&logBuf->tail, pos, __ATOMIC_RELEASE);
+    }
+
+    closeLog(fic);
+}
+
+/**
+ *  \brief Sorting the lines written in LOG_DEFER mode.
+ *
+ *  The stamped lines are put in the order of their sequence numbers (lines with the same stamp keep
+ *  their order in the file) and their stamps are removed; the header is kept first. Must be called
+ *  once all the entities have ended. Sequence numbers are assumed not to wrap around within a run.
+ *
+ *  \param nFic name of the logging file
+ */
+void sortLog (char nFic[])
+{
+    FILE *fic;                                                                                      /* file descriptor */
+    char *buf, *line, *next;
+    long size;
+    STAMPED_LINE *lines;
+    unsigned int nLines = 0, nStamped = 0, k;
+
+    if (deferFd == -1) {
+        return;
+    }
+    close (deferFd);
+    deferFd = -1;
+
+    /* reading the whole file */
+    fic = openLog(nFic,"r");
+    if ((fseek(fic, 0, SEEK_END) == -1) || ((size = ftell(fic)) == -1) || (fseek(fic, 0, SEEK_SET) == -1)) {
+        perror ("error on reading log file");
+        exit (EXIT_FAILURE);
+    }
+    if ((buf = malloc((size_t) size + 1)) == NULL) {
+        perror ("error on allocating the lines of log file");
+        exit (EXIT_FAILURE);
+    }
+    if (fread(buf, 1, (size_t) size, fic) != (size_t) size) {
+        perror ("error on reading log file");
+        exit (EXIT_FAILURE);
+    }
+    buf[size] = '\0';
+    closeLog(fic);
+
+    for(line=buf; *line != '\0'; line++) {
+        if (*line == '\n') nLines++;
+    }
+    if ((lines = malloc((nLines + 1) * sizeof(STAMPED_LINE))) == NULL) {
+        perror ("error on allocating the lines of log file");
+        exit (EXIT_FAILURE);
+    }
+
+    /* the header lines are written back as they are, while the stamped lines are collected */
+    fic = openLog(nFic,"w");
+    for(line=buf; *line != '\0'; line=next) {
+        if ((next = strchr(line, '\n')) != NULL) *next++ = '\0';
+        else next = line + strlen(line);
+        if (!isStamped(line)) {
+            fprintf(fic,"%s\n",line);
+            continue;
+        }
+        lines[nStamped].seq = (unsigned int) strtoul(line, NULL, 16);
+        lines[nStamped].pos = nStamped;
+        lines[nStamped].text = line + STAMPWIDTH;
+        nStamped++;
+    }
+    qsort(lines, nStamped, sizeof(STAMPED_LINE), cmpStamped);
+    for(k=0; k < nStamped; k++) {
+        fprintf(fic,"%s\n",lines[k].text);
+    }
+    closeLog(fic);
+
+    free(lines);
+    free(buf);
+}
+
+/**
+ *  \brief Writing the title and the column header of the log.
+ *
+ *  \param fic stream where the header is written
+ *  \param nChefs number of chefs
+ *  \param nWaiters number of waiters
+ *  \param nGroups number of groups
+ */
+void printTitle (FILE *fic, int nChefs, int nWaiters, int nGroups)
+{
+    /* title line + blank line */
+
+    fprintf (fic, "%31cRestaurant - Description of the internal state\n\n", ' ');
+    printHeader(fic, nChefs, nWaiters, nGroups);
+}
+
+/**
+ *  \brief Writing a state record as a single line, with the layout used by <tt>saveState</tt>.
+ *
+ *  \param fic stream where the line is written
+ *  \param rec pointer to the state record
+ *  \param nChefs number of chefs
+ *  \param nWaiters number of waiters
+ *  \param nGroups number of groups
+ */
+void printState (FILE *fic, LOG_RECORD *rec, int nChefs, int nWaiters, int nGroups)
+{
+    int nw = nChefs + nWaiters;
     int g;
-    for(g=0; g < p_fSt->nGroups; g++) {
-        fprintf(fic,"%4d",p_fSt->st.groupStat[g]);
+
+    for(g=0; g < nChefs; g++) {
+        fprintf(fic,(nChefs == 1) ? "%3d" : "%4d",RECCHEFSTAT(rec)[g]);
+    }
+    for(g=0; g < nWaiters; g++) {
+        fprintf(fic,(nWaiters == 1) ? "%3d" : "%4d",RECWAITERSTAT(rec, nChefs)[g]);
+    }
+    fprintf(fic,"%3d",rec->st.receptionistStat);
+    fprintf(fic," ");
+    for(g=0; g < nGroups; g++) {
+        fprintf(fic,"%4d",RECGROUPSTAT(rec, nw)[g]);
     }
 
-    fprintf(fic,"%5d",p_fSt->groupsWaiting);
+    fprintf(fic,"%5d",rec->groupsWaiting);
 
-    for(g=0; g < p_fSt->nGroups; g++) {
-        if(p_fSt->assignedTable[g]!=-1)
-            fprintf(fic,"%4d",p_fSt->assignedTable[g]);
+    for(g=0; g < nGroups; g++) {
+        if(RECTABLE(rec, nw, nGroups)[g]!=-1)
+            fprintf(fic,"%4d",RECTABLE(rec, nw, nGroups)[g]);
         else {
             fprintf(fic,"%4s",".");
         }
@@ -150,7 +816,54 @@ void saveState (char nFic[], FULL_STAT *p_fSt)
 
 
     fprintf(fic,"\n");
+}
 
-    closeLog(fic);
+/**
+ *  \brief Decoding a packed record of a binary trace file.
+ *
+ *  \param hdr pointer to the header of the trace file
+ *  \param pRec pointer to the packed record
+ *  \param rec pointer to the location where the decoded state record is stored (LOGRECSIZE(nChefs+nWaiters, nGroups) bytes)
+ */
+void unpackState (TRACE_HEADER *hdr, unsigned char *pRec, LOG_RECORD *rec)
+{
+    unsigned char *p = pRec;
+    unsigned int nw = hdr->nChefs + hdr->nWaiters;
+    unsigned int g, b;
+    int t;
+
+    for(g=0; g < nw; g++) {
+        RECCHEFSTAT(rec)[g] = *p++;                                     /* the waiters follow the chefs */
+    }
+    rec->st.receptionistStat = *p++;
+    for(g=0; g < hdr->nGroups; g++) {
+        RECGROUPSTAT(rec, nw)[g] = *p++;
+    }
+    rec->groupsWaiting = p[0] | (p[1] << 8);
+    p += 2;
+    for(g=0; g < hdr->nGroups; g++) {
+        t = 0;
+        for(b=0; b < hdr->tableBytes; b++) {
+            t |= *p++ << (8*b);
+        }
+        RECTABLE(rec, nw, hdr->nGroups)[g] = (t == (1 << (8*hdr->tableBytes)) - 1) ? -1 : t;
+    }
 }
 
+/**
+ *  \brief Decoding the columns of a state rebuilt from a binary delta file.
+ *
+ *  \param hdr pointer to the header of the delta file
+ *  \param col columns of the state
+ *  \param rec pointer to the location where the decoded state record is stored (LOGRECSIZE(nChefs+nWaiters, nGroups) bytes)
+ */
+void unpackColumns (DELTA_HEADER *hdr, const int32_t *col, LOG_RECORD *rec)
+{
+    unsigned int nw = hdr->nChefs + hdr->nWaiters;
+
+    memcpy(RECCHEFSTAT(rec), col, nw * sizeof(int));                       /* the waiters follow the chefs */
+    rec->st.receptionistStat = (unsigned int) col[nw];
+    memcpy(RECGROUPSTAT(rec, nw), col + nw + 1, hdr->nGroups * sizeof(int));
+    rec->groupsWaiting = col[nw + 1 + hdr->nGroups];
+    memcpy(RECTABLE(rec, nw, hdr->nGroups), col + nw + 2 + hdr->nGroups, hdr->nGroups * sizeof(int));
+}
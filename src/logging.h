@@ -7,7 +7,15 @@
  *
  *  Defined operations:
  *     \li file initialization
- *     \li writing the present full state as a single line at the end of the file.
+ *     \li binary trace file initialization and completion
+ *     \li binary delta file initialization (completed as a trace file)
+ *     \li binding to the shared buffer of state records
+ *     \li writing the present full state as a single line at the end of the file
+ *     \li writing the stamped state records held by the caller (LOG_DEFER mode)
+ *     \li draining the buffered state records into the file
+ *     \li sorting the lines written in LOG_DEFER mode
+ *     \li decoding and printing of trace records
+ *     \li decoding of the columns rebuilt from a delta file.
  *
  *  \author Nuno Lau - December 2023
  */
@@ -15,8 +23,113 @@
 #ifndef LOGGING_H_
 #define LOGGING_H_
 
+#include <stdio.h>
+#include <stdint.h>
+
 #include "probDataStruct.h"
 
+/** \brief identification of binary trace files */
+#define  TRACEMAGIC       "RTRC"
+/** \brief version of the binary trace format */
+#define  TRACEVERSION     2
+
+/**
+ *  \brief Definition of the <em>header of a binary trace file</em>.
+ *
+ *  The header is followed by <tt>capacity</tt> packed records of <tt>recSize</tt> bytes, of which
+ *  the first <tt>nRecords</tt> are valid. Each record holds, in this order, the state of each chef, of
+ *  each waiter and of the receptionist (1 byte each), the state of each group (1 byte each), the number
+ *  of groups waiting (2 bytes) and the table of each group (<tt>tableBytes</tt> bytes each, all ones if none).
+ */
+typedef struct {
+    /** \brief file identification (TRACEMAGIC) */
+    char magic[4];
+    /** \brief format version (TRACEVERSION) */
+    uint16_t version;
+    /** \brief number of tables */
+    uint16_t numTables;
+    /** \brief number of chefs */
+    uint16_t nChefs;
+    /** \brief number of waiters */
+    uint16_t nWaiters;
+    /** \brief number of groups */
+    uint32_t nGroups;
+    /** \brief size in bytes used to store a table id */
+    uint32_t tableBytes;
+    /** \brief size in bytes of a record */
+    uint32_t recSize;
+    /** \brief number of records that fit in the file */
+    uint32_t capacity;
+    /** \brief number of records written (updated atomically by the writers) */
+    uint32_t nRecords;
+    /** \brief number of records that did not fit in the file */
+    uint32_t lost;
+} TRACE_HEADER;
+
+/** \brief identification of binary delta files */
+#define  DELTAMAGIC       "RDLT"
+/** \brief version of the binary delta format */
+#define  DELTAVERSION     1
+/** \brief column of the event of a log line that changed no field */
+#define  DELTANOCHANGE    0xffffffffu
+
+/**
+ *  \brief Definition of the <em>header of a binary delta file</em>.
+ *
+ *  The header is followed by two sets of <tt>nColumns</tt> 32-bit columns, the state before the first line
+ *  (base) and the state of the last line written (shadow), and then by <tt>capacity</tt> events, of which
+ *  the first <tt>nEvents</tt> are valid. The columns follow the order of a log line: the state of each
+ *  chef, of each waiter and of the receptionist, the state of each group, the number of groups waiting
+ *  and the table of each group (-1 if none). Every line is one event per column it changed, or a
+ *  single DELTANOCHANGE event if it changed none, so the lines are rebuilt by applying the events to
+ *  the base in order.
+ */
+typedef struct {
+    /** \brief file identification (DELTAMAGIC) */
+    char magic[4];
+    /** \brief format version (DELTAVERSION) */
+    uint16_t version;
+    /** \brief number of tables */
+    uint16_t numTables;
+    /** \brief number of chefs */
+    uint16_t nChefs;
+    /** \brief number of waiters */
+    uint16_t nWaiters;
+    /** \brief number of groups */
+    uint32_t nGroups;
+    /** \brief number of columns of a state (nChefs + nWaiters + 1 + nGroups + 1 + nGroups) */
+    uint32_t nColumns;
+    /** \brief number of events that fit in the file */
+    uint32_t capacity;
+    /** \brief number of events written (updated with the state lock held) */
+    uint32_t nEvents;
+    /** \brief number of lines written */
+    uint32_t nLines;
+    /** \brief number of events that did not fit in the file */
+    uint32_t lost;
+} DELTA_HEADER;
+
+/**
+ *  \brief Definition of an <em>event of a binary delta file</em>: the change of a column by a log line.
+ */
+typedef struct {
+    /** \brief number of the log line (0 for the first one) */
+    uint32_t line;
+    /** \brief column changed (DELTANOCHANGE if none) */
+    uint32_t column;
+    /** \brief value of the column before the line */
+    int32_t oldVal;
+    /** \brief value of the column in the line */
+    int32_t newVal;
+} DELTA_EVENT;
+
+/** \brief base columns of the delta file whose header is pointed by h */
+#define  DELTABASE(h)     ((int32_t *) ((DELTA_HEADER *) (h) + 1))
+/** \brief shadow columns of the delta file whose header is pointed by h */
+#define  DELTASHADOW(h)   (DELTABASE (h) + (h)->nColumns)
+/** \brief events of the delta file whose header is pointed by h */
+#define  DELTAEVENT(h)    ((DELTA_EVENT *) (DELTASHADOW (h) + (h)->nColumns))
+
 /**
  *  \brief File initialization.
  *
@@ -31,6 +144,54 @@
  */
 extern void createLog (char nFic[], FULL_STAT *p_fSt);
 
+/**
+ *  \brief Binary trace file initialization.
+ *
+ *  The function creates the trace file, writes its header and reserves room for <tt>capacity</tt> records.
+ *
+ *  \param nFic name of the trace file
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ *  \param capacity number of records reserved
+ */
+extern void createTrace (char nFic[], FULL_STAT *p_fSt, unsigned int capacity);
+
+/**
+ *  \brief Binary trace file completion.
+ *
+ *  The function unmaps the trace file and cuts off the unused records.
+ *  Records that did not fit in the file are reported on stderr.
+ *
+ *  \param nFic name of the trace file
+ */
+extern void closeTrace (char nFic[]);
+
+/**
+ *  \brief Binary delta file initialization.
+ *
+ *  The function creates the delta file, writes its header and the present state as the base and
+ *  reserves room for <tt>capacity</tt> events. It is completed by <tt>closeTrace</tt>.
+ *
+ *  \param nFic name of the delta file
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ *  \param capacity number of events reserved
+ */
+extern void createDelta (char nFic[], FULL_STAT *p_fSt, unsigned int capacity);
+
+/**
+ *  \brief Binding to the shared buffer of state records.
+ *
+ *  Must be called by every process after mapping the shared region. When the buffer mode is
+ *  LOG_RING, <tt>saveState</tt> appends records to the buffer instead of writing to the file.
+ *  When it is LOG_TRACE, the trace file previously created by <tt>createTrace</tt> is mapped
+ *  and <tt>saveState</tt> appends packed records to it; a delta file previously created by <tt>createDelta</tt>
+ *  is mapped when it is LOG_DELTA and <tt>saveState</tt> appends the changes of the state to it. When it is LOG_DEFER, the logging file
+ *  is opened for appending and <tt>saveState</tt> holds stamped records until <tt>flushState</tt>.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_lb pointer to the location where the shared log buffer is stored
+ */
+extern void attachLog (char nFic[], LOG_BUFFER *p_lb);
+
 /**
  *  \brief write a log record (complete line) that includes the state of all entities and more info.
  *
@@ -41,4 +202,74 @@ extern void createLog (char nFic[], FULL_STAT *p_fSt);
  */
 extern void saveState (char nFic[], FULL_STAT *p_fSt);
 
+/**
+ *  \brief write the stamped state records held by the caller (LOG_DEFER mode).
+ *
+ *  Must be called after releasing the state lock by every caller of <tt>saveState</tt>; in any other
+ *  mode, or if no records are held, it does nothing.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ */
+extern void flushState (char nFic[], FULL_STAT *p_fSt);
+
+/**
+ *  \brief write all the state records published in the shared buffer, in the order they were saved.
+ *
+ *  The layout of each line is the same used by <tt>saveState</tt> in LOG_TEXT mode.
+ *  Only one process (the drain) may call this function.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ */
+extern void drainLog (char nFic[], FULL_STAT *p_fSt);
+
+/**
+ *  \brief sort the lines written in LOG_DEFER mode by the sequence numbers of their states and remove their stamps.
+ *
+ *  Must be called once all the entities have ended.
+ *
+ *  \param nFic name of the logging file
+ */
+extern void sortLog (char nFic[]);
+
+/**
+ *  \brief write the title and the column header of the log.
+ *
+ *  \param fic stream where the header is written
+ *  \param nChefs number of chefs
+ *  \param nWaiters number of waiters
+ *  \param nGroups number of groups
+ */
+extern void printTitle (FILE *fic, int nChefs, int nWaiters, int nGroups);
+
+/**
+ *  \brief write a state record as a single line, with the layout used by <tt>saveState</tt>.
+ *
+ *  \param fic stream where the line is written
+ *  \param rec pointer to the state record
+ *  \param nChefs number of chefs
+ *  \param nWaiters number of waiters
+ *  \param nGroups number of groups
+ */
+extern void printState (FILE *fic, LOG_RECORD *rec, int nChefs, int nWaiters, int nGroups);
+
+/**
+ *  \brief decode a packed record of a binary trace file.
+ *
+ *  \param hdr pointer to the header of the trace file
+ *  \param pRec pointer to the packed record
+ *  \param rec pointer to the location where the decoded state record is stored (LOGRECSIZE(nChefs+nWaiters, nGroups) bytes)
+ */
+extern void unpackState (TRACE_HEADER *hdr, unsigned char *pRec, LOG_RECORD *rec);
+
+/**
+ *  \brief decode the columns of a state rebuilt from a binary delta file.
+ *
+ *  \param hdr pointer to the header of the delta file
+ *  \param col columns of the state
+ *  \param rec pointer to the location where the decoded state record is stored (LOGRECSIZE(nChefs+nWaiters, nGroups) bytes)
+ */
+extern void unpackColumns (DELTA_HEADER *hdr, const int32_t *col, LOG_RECORD *rec);
+
 #endif /* LOGGING_H_ */
@@ -0,0 +1,167 @@
+/**
+ *  \file monitor.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Live monitor of a running simulation.
+ *
+ *  Attaches to the shared region of the simulation and samples the full state at a fixed rate, without
+ *  taking the state lock: each copy is enclosed between beginRead and endRead and taken again if an update
+ *  took place meanwhile, so the entities never wait for the monitor.
+ *
+ *  One line is printed per sample: the elapsed time, the rate of state updates, the number of groups
+ *  waiting for table, the tables in use, the number of groups in each state (GO going to the restaurant,
+ *  RC at reception, FR requesting food, WF waiting for food, EA eating, CO checking out, LV leaving), the
+ *  chefs cooking, the waiters busy, the orders not yet taken by a chef, the dishes not yet taken by a
+ *  waiter and the reads that were taken again. The monitor ends when all the groups have left.
+ *
+ *  Options:
+ *    \li -k key  access key to the shared memory (default generated by ftok, as the simulation does)
+ *    \li -i interval  sampling period in milliseconds (default 100)
+ *    \li -n samples  number of samples (default 0, until all the groups have left).
+ *
+ *  The shared region of the threaded build is private to its process and cannot be monitored.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+
+#include "probConst.h"
+#include "probDataStruct.h"
+#include "sharedDataSync.h"
+#include "sharedMemory.h"
+
+/* internal functions */
+
+static double now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ *  \brief copies the state, the arrays indexed by group, by waiter and by chef included, without the state lock.
+ *
+ *  \param p_fSt pointer to the full internal state of the problem (in the shared region)
+ *  \param snap pointer to the copy
+ *  \param size size in bytes of the copy
+ *
+ *  \return number of copies taken again
+ */
+static unsigned int snapshot (const FULL_STAT *p_fSt, FULL_STAT *snap, size_t size)
+{
+    unsigned int seq, retries = 0;
+
+    while (true) {
+        seq = beginRead (p_fSt);
+        if ((seq & 1) == 0) {
+            memcpy (snap, p_fSt, size);
+            if (endRead (p_fSt, seq))
+                return retries;
+        }
+        retries += 1;
+        sched_yield ();                                          /* let the writer finish its update */
+    }
+}
+
+/**
+ *  \brief Main program.
+ */
+int main (int argc, char *argv[])
+{
+    int key = -1, shmid, opt;
+    unsigned int period = 100, samples = 0, s, retries;
+    char *tinp;
+    SHARED_DATA *sh;
+    FULL_STAT *snap;
+    size_t size;
+    unsigned int prevSeq;
+    double start, prevTime, t;
+    int count[LEAVING+1], tables, cooking, busy, g;
+
+    while ((opt = getopt (argc, argv, "k:i:n:")) != -1) {
+        switch (opt) {
+            case 'k': key = (int) strtol (optarg, &tinp, 0); break;
+            case 'i': period = (unsigned int) strtoul (optarg, &tinp, 0); break;
+            case 'n': samples = (unsigned int) strtoul (optarg, &tinp, 0); break;
+            default: tinp = "?";
+        }
+        if (*tinp != '\0') {
+            fprintf (stderr, "USAGE: %s [-k key] [-i interval] [-n samples]\n", argv[0]);
+            exit (EXIT_FAILURE);
+        }
+    }
+    if ((period == 0) || ((key == -1) && ((key = ftok (".", 'a')) == -1))) {
+        fprintf (stderr, "Wrong argument value!\n");
+        exit (EXIT_FAILURE);
+    }
+
+    /* the monitor may be started before the simulation: it waits for the shared region and its first update */
+    while ((shmid = shmemConnect (key)) == -1) {
+        if (errno != ENOENT) {
+            perror ("error on connecting to the shared memory region");
+            exit (EXIT_FAILURE);
+        }
+        usleep (period * 1000);
+    }
+    if (shmemAttach (shmid, (void **) &sh) == -1) {
+        perror ("error on mapping the shared region on the process address space");
+        exit (EXIT_FAILURE);
+    }
+    while (beginRead (&sh->fSt) == 0)
+        usleep (period * 1000);
+
+    size = sh->fSt.chefStatOff + (size_t) sh->fSt.nChefs * sizeof (unsigned int);
+    if ((snap = malloc (size)) == NULL) {
+        perror ("error on allocating the copy of the state");
+        exit (EXIT_FAILURE);
+    }
+
+    printf ("%8s %9s %4s %11s %5s %5s %5s %5s %5s %5s %5s %9s %9s %6s %6s %7s\n", "time(s)", "upd/s", "gWT", "tables",
+            "GO", "RC", "FR", "WF", "EA", "CO", "LV", "cooking", "serving", "orders", "dishes", "retries");
+    start = prevTime = now ();
+    prevSeq = beginRead (&sh->fSt);
+    for (s = 0; (samples == 0) || (s < samples); s++) {
+        usleep (period * 1000);
+        retries = snapshot (&sh->fSt, snap, size);
+        t = now ();
+
+        memset (count, 0, sizeof (count));
+        for (g = 0, tables = 0; g < snap->nGroups; g++) {
+            if (GROUPSTAT(snap)[g] <= LEAVING) count[GROUPSTAT(snap)[g]] += 1;
+            if (ASSIGNEDTABLE(snap)[g] != -1) tables += 1;
+        }
+        for (g = 0, cooking = 0; g < snap->nChefs; g++)
+            if (CHEFSTAT(snap)[g] == COOK) cooking += 1;
+        for (g = 0, busy = 0; g < snap->nWaiters; g++)
+            if (WAITERSTAT(snap)[g] != WAIT_FOR_REQUEST) busy += 1;
+
+        printf ("%8.2f %9.0f %4d %5d/%-5d %5d %5d %5d %5d %5d %5d %5d %4d/%-4d %4d/%-4d %6u %6u %7u\n", t - start,
+                (snap->seq - prevSeq) / 2 / (t - prevTime), snap->groupsWaiting, tables, snap->nTables,
+                count[GOTOREST], count[ATRECEPTION], count[FOOD_REQUEST], count[WAIT_FOR_FOOD], count[EAT],
+                count[CHECKOUT], count[LEAVING], cooking, snap->nChefs, busy, snap->nWaiters,
+                snap->orderHead - snap->orderTail, snap->readyHead - snap->readyTail, retries);
+        fflush (stdout);
+        prevSeq = snap->seq;
+        prevTime = t;
+        if (count[LEAVING] == snap->nGroups)
+            break;
+    }
+
+    free (snap);
+    if (shmemDettach (sh) == -1) {
+        perror ("error on unmapping the shared region off the process address space");
+        exit (EXIT_FAILURE);
+    }
+    return EXIT_SUCCESS;
+}
@@ -13,18 +13,41 @@
 
 /* Generic parameters */
 
-/** \brief maximum number of groups */
-#define  MAXGROUPS       16 
-/** \brief number of tables */
+/** \brief number of tables (when not set in the config file) */
 #define  NUMTABLES        2 
 /** \brief controls time taken to cook */
 #define  MAXCOOK        100
+/** \brief time added to the cooking of a batch by each order after the first one */
+#define  BATCHCOOK       20
 
 /** \brief controls start time standard deviation */
 #define  STARTDEV         4 
 /** \brief controls eat time standard deviation */
 #define  EATDEV           4 
 
+/** \brief size in bytes of a cache line (unit of the layout of the shared region when CACHEALIGN is defined) */
+#define  CACHELINE       64
+
+/** \brief number of requests from groups held by the receptionist and the waiter request queues (the number of
+           slots of a queue, and the largest number of requests taken from it at once) */
+#define  REQQUEUESIZE     8
+
+/** \brief number of state records held by the shared log ring buffer */
+#define  LOGRINGSIZE   1024
+/** \brief period (in microseconds) between two drains of the log ring buffer */
+#define  LOGDRAINPERIOD 1000
+/** \brief number of records reserved in the binary trace file for a run with n groups */
+#define  TRACERECORDS(n)  (32*(n)+64)
+/** \brief number of events reserved in the binary delta file for a run with n groups */
+#define  DELTAEVENTS(n)   (64*(n)+128)
+/** \brief default time (in seconds) without any update of the state, and with no entity letting time pass, after
+           which a run is taken as stalled */
+#define  STALLTIME        5
+/** \brief period (in microseconds) between two checks of the progress of a run */
+#define  STALLPERIOD      10000
+/** \brief number of stamped state records an entity may hold before writing them (LOG_DEFER mode) */
+#define  DEFERRECORDS     4
+
 /** \brief id of table request (group->receptionist) */
 #define TABLEREQ   1
 /** \brief id of bill request (group->receptionist) */
@@ -33,6 +56,30 @@
 #define FOODREQ   3
 /** \brief id of food ready (chef->waiter) */
 #define FOODREADY 4
+/** \brief id of no request (all the requests were taken by other waiters) */
+#define NOREQ     0
+
+/* Table scheduling policy constants (receptionist) */
+
+/** \brief the group that has been waiting the longest takes the vacant table */
+#define  POLICY_FIFO       0
+/** \brief the waiting group with the shortest expected eat time (eatTime) takes the vacant table */
+#define  POLICY_SEF        1
+/** \brief the waiting group with the lowest id takes the vacant table */
+#define  POLICY_INDEX      2
+
+/* Logging mode constants */
+
+/** \brief every state change is formatted and written to the log file by the caller */
+#define  LOG_TEXT          0
+/** \brief state changes are appended as binary records to a shared ring buffer */
+#define  LOG_RING          1
+/** \brief state changes are appended as packed records to a memory-mapped trace file */
+#define  LOG_TRACE         2
+/** \brief state changes are copied and stamped under the state lock, and formatted by the caller after releasing it */
+#define  LOG_DEFER         3
+/** \brief only the fields changed by each state change are appended as events to a memory-mapped delta file */
+#define  LOG_DELTA         4
 
 /* Client state constants */
 
@@ -76,5 +123,16 @@
 /** \brief receptionist reiceives payment */
 #define  RECVPAY            2
 
+/* Group latency constants */
+
+/** \brief time from arrival at the restaurant until a table is assigned */
+#define  LAT_TABLE          0
+/** \brief time from the assignment of a table until food arrives */
+#define  LAT_FOOD           1
+/** \brief time from the end of the meal until payment is acknowledged */
+#define  LAT_CHECKOUT       2
+/** \brief number of measured latencies */
+#define  NLATENCY           3
+
 
 #endif /* PROBCONST_H_ */
@@ -14,6 +14,7 @@
 #define PROBDATASTRUCT_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "probConst.h"
 
@@ -28,56 +29,234 @@ typedef struct {
 } request;
 
 
+/**
+ *  \brief Definition of a bounded queue of requests.
+ *
+ *  Producers fill slot <tt>head</tt> and consumers take requests from slot <tt>tail</tt>; both
+ *  positions only grow, and are reduced modulo REQQUEUESIZE when indexing the slots.
+ */
+typedef struct {
+    /** \brief position of the next slot to be filled */
+    unsigned int head;
+    /** \brief position of the next request to be taken */
+    unsigned int tail;
+    /** \brief requests */
+    request slot[REQQUEUESIZE];
+} REQ_QUEUE;
+
+
+#ifdef CACHEALIGN
+/** \brief starts a field on a cache line of its own (cache-aligned layout, <tt>make CACHEALIGN=1</tt>) */
+#define  HOTLINE                __attribute__ ((aligned (CACHELINE)))
+/** \brief size n rounded up to a whole number of cache lines */
+#define  LINEUP(n)              (((n) + CACHELINE - 1) / CACHELINE * CACHELINE)
+#else
+/** \brief starts a field on a cache line of its own (only in the cache-aligned layout) */
+#define  HOTLINE
+/** \brief size n rounded up to a whole number of cache lines (only in the cache-aligned layout) */
+#define  LINEUP(n)              (n)
+#endif
+
+/** \brief address of the array of <tt>type</tt> stored <tt>off</tt> bytes after the start of the structure pointed by <tt>p</tt> */
+#define  ARRAYAT(p,off,type)    ((type *) ((char *) (p) + (off)))
+
 /**
  *  \brief Definition of <em>state of the intervening entities</em> data type.
+ *
+ *  The states of the waiters, of the chefs and of each group are kept apart, in arrays sized at runtime
+ *  (see WAITERSTAT, CHEFSTAT and GROUPSTAT).
  */
 typedef struct {
     /** \brief receptionist state */
     unsigned int receptionistStat;
-    /** \brief waiter state */
-    unsigned int waiterStat;
-    /** \brief chef state */
-    unsigned int chefStat;
-    /** \brief group state array */
-    unsigned int groupStat[MAXGROUPS];          //array de estados de cada grupo
 
 } STAT;
 
 
 /**
  *  \brief Definition of <em>full state of the problem</em> data type.
+ *
+ *  The arrays indexed by group, waiter or chef are sized at runtime and laid out in the shared region
+ *  after the fixed part; their offsets from the start of the structure are stored here and resolved by
+ *  the GROUPSTAT, STARTTIME, EATTIME, ASSIGNEDTABLE, ORDERGROUP, READYGROUP, WAITERSTAT and CHEFSTAT macros.
+ *
+ *  Each group orders food once, so the food orders (from the waiters to the chefs) and the dishes
+ *  ready (from the chefs to the waiters) are kept in first-in first-out arrays of one entry per group,
+ *  whose positions only grow and never wrap around.
+ *
+ *  The fields are grouped by the lock that protects them, after the sizes and offsets, which are not
+ *  changed once the run starts. In the cache-aligned layout (CACHEALIGN defined) each group starts on
+ *  a cache line of its own, so entities that hold different locks do not write to the same line.
  */
 typedef struct
-{   /** \brief state of all intervening entities */
-    STAT st;
-
-    /** \brief number of groups */
+{   /** \brief number of groups */
     int nGroups;
+    /** \brief number of tables */
+    int nTables;
+    /** \brief number of waiters */
+    int nWaiters;
+    /** \brief number of chefs */
+    int nChefs;
+    /** \brief kitchen batch mode: a chef takes all the pending orders and cooks them together */
+    bool batchOrders;
+    /** \brief table scheduling policy of the receptionist (POLICY_FIFO, POLICY_SEF or POLICY_INDEX) */
+    unsigned int tablePolicy;
+
+    /** \brief offset of the group state array */
+    size_t groupStatOff;
+    /** \brief offset of the array of estimated start time of groups */
+    size_t startTimeOff;
+    /** \brief offset of the array of estimated eat time of groups */
+    size_t eatTimeOff;
+    /** \brief offset of the array that saves the table that is being used by each group */
+    size_t assignedTableOff;
+    /** \brief offset of the array of groups whose food was ordered to the chefs, in order */
+    size_t orderGroupOff;
+    /** \brief offset of the array of groups whose food is ready, in order */
+    size_t readyGroupOff;
+    /** \brief offset of the waiter state array */
+    size_t waiterStatOff;
+    /** \brief offset of the chef state array */
+    size_t chefStatOff;
+
+    /** \brief state of all intervening entities (state lock) */
+    STAT st HOTLINE;
+
+    /** \brief sequence number of the state, odd while an update is in progress (seqlock) */
+    unsigned int seq;
+
     /** \brief number of groups waiting for table */
     int groupsWaiting;
 
-    /** \brief estimated start time of groups */
-    int startTime[MAXGROUPS];
-    /** \brief estimated eat time of groups */
-    int eatTime[MAXGROUPS];
+    /** \brief number of food orders issued by the waiters and taken by the chefs (kitchen region) */
+    unsigned int orderHead HOTLINE, orderTail;
 
-    /** \brief saves the table that is being used by each group */
-    int assignedTable[MAXGROUPS];
+    /** \brief number of dishes ready issued by the chefs and taken by the waiters (waiter region) */
+    unsigned int readyHead HOTLINE, readyTail;
 
-    /** \brief flag of food request from waiter to chef */
-    int foodOrder;
-    /** \brief group associated to food request from waiter to chef */
-    int foodGroup;
+    /** \brief used by groups to queue requests to waiter (waiter region) */
+    REQ_QUEUE waiterQueue;
 
+    /** \brief used by groups to queue requests to receptionist (reception region) */
+    REQ_QUEUE receptionistQueue HOTLINE;
 
-    /** \brief used by groups to store request to receptionist */
-    request receptionistRequest;
+} FULL_STAT;
 
-    /** \brief used by groups and chef to store request to waiter */
-    request waiterRequest;
+/** \brief group state array (p points to the full state) */
+#define  GROUPSTAT(p)       ARRAYAT (p, (p)->groupStatOff, unsigned int)
+/** \brief estimated start time of groups (p points to the full state) */
+#define  STARTTIME(p)       ARRAYAT (p, (p)->startTimeOff, int)
+/** \brief estimated eat time of groups (p points to the full state) */
+#define  EATTIME(p)         ARRAYAT (p, (p)->eatTimeOff, int)
+/** \brief table being used by each group, -1 if none (p points to the full state) */
+#define  ASSIGNEDTABLE(p)   ARRAYAT (p, (p)->assignedTableOff, int)
+/** \brief groups whose food was ordered to the chefs, in order (p points to the full state) */
+#define  ORDERGROUP(p)      ARRAYAT (p, (p)->orderGroupOff, int)
+/** \brief groups whose food is ready, in order (p points to the full state) */
+#define  READYGROUP(p)      ARRAYAT (p, (p)->readyGroupOff, int)
+/** \brief waiter state array (p points to the full state) */
+#define  WAITERSTAT(p)      ARRAYAT (p, (p)->waiterStatOff, unsigned int)
+/** \brief chef state array (p points to the full state) */
+#define  CHEFSTAT(p)        ARRAYAT (p, (p)->chefStatOff, unsigned int)
 
+/**
+ *  \brief Definition of <em>table report</em> data type.
+ *
+ *  Use of the tables, as seen by the receptionist (times in microseconds, as given by simNow); it is
+ *  filled by the receptionist when its life cycle ends.
+ */
+typedef struct {
+    /** \brief number of groups seated */
+    unsigned int seated;
+    /** \brief sum of the waits of the groups, from their table request to the assignment of a table */
+    unsigned long long waitSum;
+    /** \brief sum of the times the tables were occupied, from their assignment to the payment */
+    unsigned long long busySum;
+    /** \brief time of the first table request */
+    unsigned long long first;
+    /** \brief time of the last payment */
+    unsigned long long last;
+} TABLE_REPORT;
 
-} FULL_STAT;
+/**
+ *  \brief Definition of <em>entity pool</em> data type.
+ *
+ *  The intervening entities started by the generator, which may take part in several runs (server mode):
+ *  their number of each kind is the capacity of the pool, set by the first scenario, and each one waits for
+ *  the start of a run on a semaphore of its own.
+ */
+typedef struct {
+    /** \brief the entities take part in several runs */
+    bool server;
+    /** \brief the entities must end instead of taking part in another run */
+    bool quit;
+    /** \brief identification of semaphore used by the generator to wait for the end of the run of the entities
+               (one unit each) – val = 0 */
+    unsigned int runDone;
+    /** \brief identification of semaphore used by the receptionist to wait for the start of a run (entity e of
+               the pool uses nextRun+e) – val = 0 */
+    unsigned int nextRun;
+    /** \brief number of waiters of the pool */
+    int nWaiters;
+    /** \brief number of chefs of the pool */
+    int nChefs;
+    /** \brief number of groups of the pool */
+    int nGroups;
+} ENTITY_POOL;
+
+/**
+ *  \brief Definition of <em>state record</em> data type.
+ *
+ *  Binary image of a single log line; its size depends on the number of workers (chefs and waiters)
+ *  and of groups (see LOGRECSIZE).
+ */
+typedef struct {
+    /** \brief state of the receptionist */
+    STAT st;
+    /** \brief number of groups waiting for table */
+    int groupsWaiting;
+    /** \brief state of each chef, of each waiter and of each group, followed by the table being used by each group */
+    int ent[];
+} LOG_RECORD;
+
+/** \brief size in bytes of a state record for a run with nw workers (chefs and waiters) and n groups */
+#define  LOGRECSIZE(nw,n)      (sizeof (LOG_RECORD) + ((size_t) (nw) + 2 * (size_t) (n)) * sizeof (int))
+/** \brief chef state array of the state record r */
+#define  RECCHEFSTAT(r)        ((r)->ent)
+/** \brief waiter state array of the state record r of a run with nc chefs */
+#define  RECWAITERSTAT(r,nc)   ((r)->ent + (nc))
+/** \brief group state array of the state record r of a run with nw workers */
+#define  RECGROUPSTAT(r,nw)    ((r)->ent + (nw))
+/** \brief table being used by each group in the state record r of a run with nw workers and n groups */
+#define  RECTABLE(r,nw,n)      ((r)->ent + (nw) + (n))
+
+
+/**
+ *  \brief Definition of <em>log buffer</em> data type.
+ *
+ *  Ring of state records shared by all processes. Writers reserve a slot by atomically
+ *  incrementing <tt>head</tt> and publish it by storing its position + 1 in <tt>ready</tt>;
+ *  the drain formats published records in order and advances <tt>tail</tt>.
+ *  The records are laid out after the fixed part (see LOGREC); room for them is only reserved in
+ *  LOG_RING mode.
+ */
+typedef struct {
+    /** \brief logging mode (LOG_TEXT, LOG_RING, LOG_TRACE, LOG_DEFER or LOG_DELTA) */
+    unsigned int mode;
+    /** \brief size in bytes of a state record (whole cache lines in the cache-aligned layout) */
+    unsigned int recSize;
+    /** \brief offset of the state records */
+    size_t recOff;
+    /** \brief position of the next slot to be reserved by a writer */
+    unsigned int head HOTLINE;
+    /** \brief position of the next record to be formatted by the drain */
+    unsigned int tail HOTLINE;
+    /** \brief position + 1 of the record published in each slot */
+    unsigned int ready[LOGRINGSIZE] HOTLINE;
+} LOG_BUFFER;
+
+/** \brief state record stored in slot s of the log buffer pointed by lb */
+#define  LOGREC(lb,s)       ARRAYAT (lb, (lb)->recOff + (size_t) (s) * (lb)->recSize, LOG_RECORD)
 
 
 #endif /* PROBDATASTRUCT_H_ */
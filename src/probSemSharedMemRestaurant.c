@@ -11,6 +11,58 @@
  *  Upon execution, one parameter is requested:
  *    \li name of the logging file.
  *
+ *  Options:
+ *    \li -l text|ring|trace|defer|delta  logging mode (default text); in ring mode the entities only buffer state
+ *        records in shared memory and this process formats them into the logging file; in trace
+ *        mode packed records are appended to a memory-mapped binary file (see logRender); in defer
+ *        mode the entities only copy the state, stamped with its sequence number, while holding the
+ *        state lock and write the lines after releasing it, and this process sorts them at the end; in
+ *        delta mode only the fields changed by each state change are appended as events to a
+ *        memory-mapped binary file, from which logRender rebuilds the text log.
+ *    \li -k key  access key to shared memory and semaphore set (default generated by ftok), so that
+ *        several simulations may run at the same time in the same directory.
+ *    \li -c file  scenario file (default config.txt); with -, the scenario is read from the standard
+ *        input, so it may be piped from genScenario. Besides the number of tables, the scenario may set
+ *        the number of waiters and of chefs (sections #nwaiters and #nchefs, default 1), which share the
+ *        requests and the food orders, the seed of the run (section #seed) and the table scheduling
+ *        policy (section #policy). The file may also be a compiled scenario (genScenario -B), whose times
+ *        are copied into the shared region without being parsed (see scenario.h).
+ *    \li -s seed  seed of the run (default the #seed section of the scenario file or, when there is none,
+ *        one drawn from the clock): the times of the groups and of the chefs are drawn by every entity
+ *        from a stream of its own (see rng.h), so the same seed always gives the same schedule.
+ *    \li -P fifo|sef|index  table scheduling policy of the receptionist (default the #policy section of the
+ *        scenario file or, when there is none, fifo): a vacant table is given to the group that has been
+ *        waiting the longest, to the one with the shortest expected eat time or to the one with the lowest id.
+ *    \li -b  kitchen batch mode: a chef takes all the pending orders at once and cooks them together
+ *        (when there is a single chef).
+ *    \li -H file  print the latencies of the groups (time to table, time to food and time to checkout)
+ *        and the use of the tables (throughput, utilization, mean wait and turnover) at the end; unless
+ *        file is -, the histograms of the run are first added to those stored in the file, so the summary
+ *        covers all the runs that used it.
+ *    \li -m huge,prefault,lock  options of the shared region (comma separated): backed by huge pages (they
+ *        must have been reserved, see /proc/sys/vm/nr_hugepages), pre-faulted by every entity before its
+ *        life cycle starts, or locked in memory (which pre-faults it too), so that the latencies measured
+ *        are not disturbed by page faults.
+ *    \li -W seconds  watchdog (default STALLTIME, 0 disables it): when the state is not updated for so
+ *        long, and no entity is letting time pass meanwhile (going to the restaurant, eating or cooking), the
+ *        state of every entity and the values of the semaphores are printed on stderr, the intervening
+ *        entities are terminated and the program ends with status STALLEXIT.
+ *    \li -S  server mode: the names of the scenario files are read from the standard input, one per line
+ *        (-c is not used), and the runs are carried out one after the other by the same entity processes
+ *        over the same shared region and semaphore set, which are reset in place between runs. The first
+ *        scenario sets the capacity (the number of groups, tables, waiters and chefs); a later one that
+ *        does not fit is skipped. A line naming the scenario is printed after each run, followed by its
+ *        latencies and semaphore statistics, and the logging file is written anew by each run. Only in the
+ *        text and ring logging modes, and not in the threaded build nor with the virtual-time backend.
+ *
+ *  In the instrumented build (SEMSTATS defined, <tt>make SEMSTATS=1</tt>) the number of operations, the time
+ *  spent in them, the time the locks were held and the system calls made by the intervening entities on every
+ *  semaphore are printed at the end.
+ *
+ *  In the threaded build (THREADED defined, <tt>make threaded</tt>) the life cycles of the intervening
+ *  entities are linked into this program and run by threads over an in-process shared region,
+ *  instead of being forked and executed as separate programs.
+ *
  *  \author Nuno Lau - December 2023
  */
 
@@ -19,17 +71,27 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#ifdef THREADED
+#include <pthread.h>
+#endif
 
 #include "probConst.h"
 #include "probDataStruct.h"
 #include "logging.h"
 #include "sharedDataSync.h"
 #include "semaphore.h"
+#include "semStats.h"
 #include "sharedMemory.h"
+#include "simClock.h"
+#include "scenario.h"
 
 /** \brief name of chef process */
 #define   CHEF               "./chef"
@@ -42,6 +104,461 @@
 
 /** \brief name of chef process */
 #define   RECEPTIONIST       "./receptionist"
+
+/** \brief exit status of a run ended by the watchdog */
+#define   STALLEXIT          3
+
+#ifdef THREADED
+/** \brief stack size of the threads that run the intervening entities */
+#define   ENTITYSTACK        (256*1024)
+
+/** \brief life cycles of the intervening entities */
+extern int chefMain (int argc, char *argv[]);
+extern int waiterMain (int argc, char *argv[]);
+extern int groupMain (int argc, char *argv[]);
+extern int receptionistMain (int argc, char *argv[]);
+
+/**
+ *  \brief Definition of an intervening entity run by a thread.
+ */
+typedef struct {
+    /** \brief life cycle */
+    int (*life) (int argc, char *argv[]);
+    /** \brief number of parameters */
+    int argc;
+    /** \brief parameters, as they would appear in the command line */
+    char *argv[6];
+    /** \brief storage of the parameters */
+    char arg[5][52];
+    /** \brief thread identifier */
+    pthread_t thread;
+} ENTITY;
+
+/** \brief number of intervening entities whose life cycle is over */
+static unsigned int nDone = 0;
+
+/**
+ *  \brief Thread body: runs the life cycle of an intervening entity.
+ *
+ *  \param arg pointer to the entity
+ */
+static void *runEntity (void *arg)
+{
+    ENTITY *ent = (ENTITY *) arg;
+
+    ent->life (ent->argc, ent->argv);
+    __atomic_fetch_add (&nDone, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ *  \brief Starts a thread that runs the life cycle of an intervening entity.
+ *
+ *  \param ent pointer to the entity
+ *  \param life life cycle
+ *  \param argc number of parameters
+ *  \param argv parameters (they are copied)
+ */
+static void startEntity (ENTITY *ent, int (*life) (int, char *[]), int argc, char *argv[])
+{
+    pthread_attr_t attr;
+    int a;
+
+    ent->life = life;
+    ent->argc = argc;
+    for (a = 0; a < argc; a++) {
+        strncpy (ent->arg[a], argv[a], sizeof (ent->arg[a]) - 1);
+        ent->arg[a][sizeof (ent->arg[a]) - 1] = '\0';
+        ent->argv[a] = ent->arg[a];
+    }
+    ent->argv[argc] = NULL;
+    pthread_attr_init (&attr);
+    pthread_attr_setstacksize (&attr, ENTITYSTACK);
+    if ((errno = pthread_create (&ent->thread, &attr, runEntity, ent)) != 0) {
+        perror ("error on the creation of an entity thread");
+        exit (EXIT_FAILURE);
+    }
+    pthread_attr_destroy (&attr);
+}
+#endif
+/**
+ *  \brief Composes the name of a semaphore, as in sharedDataSync.h.
+ *
+ *  \param sh pointer to shared memory region
+ *  \param sindex semaphore location in the set
+ *  \param name storage of the name
+ */
+static void semName (SHARED_DATA *sh, unsigned int sindex, char name[])
+{
+    static const char *fixed[] = {"", "MUTEX", "RECEPTIONISTREQ", "RECEPTIONISTREQUESTPOSSIBLE", "WAITERREQUEST",
+                                  "WAITERREQUESTPOSSIBLE", "WAITORDER", "RECEPTIONLOCK",
+                                  "WAITERLOCK", "KITCHENLOCK"};
+
+    if (sindex < WAITFORTABLE) strcpy (name, fixed[sindex]);
+    else if (sindex < FOODARRIVED) sprintf (name, "WAITFORTABLE+%u", sindex - WAITFORTABLE);
+    else if (sindex < REQUESTRECEIVED) sprintf (name, "FOODARRIVED+%u", sindex - FOODARRIVED);
+    else if (sindex < TABLEDONE) sprintf (name, "REQUESTRECEIVED+%u", sindex - REQUESTRECEIVED);
+    else sprintf (name, "TABLEDONE+%u", sindex - TABLEDONE);
+}
+
+/**
+ *  \brief Checks the progress of the run (called once in a while by the watchdog).
+ *
+ *  An update of the state is progress, and so is an entity letting time pass (see passTime), since a
+ *  meal or a cooking may take longer than <tt>stallTime</tt>.
+ *
+ *  \param sh pointer to shared memory region
+ *  \param stallTime time (in seconds) without any progress after which the run is stalled
+ *
+ *  \return true if the run made no progress for <tt>stallTime</tt> seconds, false otherwise
+ */
+static bool stalled (SHARED_DATA *sh, unsigned int stallTime)
+{
+    static unsigned int lastSeq = 0;                                        /* sequence number last seen */
+    static unsigned long long lastChange = 0;                                          /* time it was seen */
+    unsigned int seq = __atomic_load_n (&sh->fSt.seq, __ATOMIC_RELAXED);
+    struct timespec ts;
+    unsigned long long now;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    now = (unsigned long long) ts.tv_sec * 1000000 + (unsigned long long) ts.tv_nsec / 1000;
+    if ((lastChange == 0) || (seq != lastSeq) || (__atomic_load_n (&sh->sleeping, __ATOMIC_RELAXED) > 0)) {
+        lastSeq = seq;
+        lastChange = now;
+        return false;
+    }
+    return now - lastChange >= (unsigned long long) stallTime * 1000000;
+}
+
+/**
+ *  \brief Prints the state of every entity that did not end and the values of the semaphores.
+ *
+ *  The state is read without the state lock, as its holder may be stuck; the values of the semaphores
+ *  associated with groups and tables are only printed when they are not zero.
+ *
+ *  \param fp stream where the report is printed
+ *  \param sh pointer to shared memory region
+ *  \param semgid semaphore set access identifier
+ *  \param stallTime time (in seconds) without any update of the state
+ */
+static void printStall (FILE *fp, SHARED_DATA *sh, int semgid, unsigned int stallTime)
+{
+    FULL_STAT *p_fSt = &sh->fSt;
+    char name[40];
+    unsigned int s;
+    int g, val;
+
+    fprintf (fp, "no update of the state for %u s (%u updates so far, seed %llu): the run is stalled\n", stallTime,
+             p_fSt->seq / 2, sh->seed);
+    fprintf (fp, "receptionist  state %d\n", p_fSt->st.receptionistStat);
+    for (g = 0; g < p_fSt->nWaiters; g++)
+        fprintf (fp, "waiter %-6d state %d\n", g, WAITERSTAT(p_fSt)[g]);
+    for (g = 0; g < p_fSt->nChefs; g++)
+        fprintf (fp, "chef %-8d state %d\n", g, CHEFSTAT(p_fSt)[g]);
+    for (g = 0; g < p_fSt->nGroups; g++)
+        if (GROUPSTAT(p_fSt)[g] != LEAVING)
+            fprintf (fp, "group %-7d state %d table %d\n", g, GROUPSTAT(p_fSt)[g], ASSIGNEDTABLE(p_fSt)[g]);
+    fprintf (fp, "groups waiting for table %d, orders taken by the chefs %u/%u, dishes taken by the waiters %u/%u\n",
+             p_fSt->groupsWaiting, p_fSt->orderTail, p_fSt->orderHead, p_fSt->readyTail, p_fSt->readyHead);
+    for (s = 1; s <= SEM_NU; s++) {
+        if ((val = semGetValue (semgid, s)) == -1) {
+            perror ("error on reading the value of a semaphore");
+            return;
+        }
+        if ((val == 0) && (s >= WAITFORTABLE)) continue;
+        semName (sh, s, name);
+        fprintf (fp, "semaphore %-28s %d\n", name, val);
+    }
+}
+
+/**
+ *  \brief Prints the use of the tables under the table scheduling policy of the run.
+ *
+ *  The throughput is the number of groups served per second between the first table request and the last
+ *  payment; the utilization is the fraction of that span the tables were occupied; the turnover is the
+ *  number of groups seated per table and per second.
+ *
+ *  \param fp stream where the report is printed
+ *  \param sh pointer to shared memory region
+ */
+static void printTables (FILE *fp, SHARED_DATA *sh)
+{
+    TABLE_REPORT *r = &sh->tables;
+    double span = (r->last > r->first) ? (r->last - r->first) / 1e6 : 0.0;             /* in seconds */
+
+    if ((r->seated == 0) || (span == 0.0)) {
+        fprintf (fp, "tables policy=%s no group served\n", policyName[sh->fSt.tablePolicy]);
+        return;
+    }
+    fprintf (fp, "tables policy=%s served=%u span=%.3f s throughput=%.1f groups/s utilization=%.1f%% "
+                 "mean-wait=%.0f us turnover=%.2f groups/table/s\n", policyName[sh->fSt.tablePolicy], r->seated,
+             span, r->seated / span, 100.0 * r->busySum / 1e6 / (span * sh->fSt.nTables),
+             (double) r->waitSum / r->seated, r->seated / span / sh->fSt.nTables);
+}
+
+#ifdef SEMSTATS
+
+/**
+ *  \brief Prints the semaphore statistics of the receptionist, the waiters, the chefs and the groups.
+ *
+ *  The statistics of the entities of each kind are added up (the maximum is the largest one of all of them).
+ *  The holding time is only meaningful for the semaphores used as locks.
+ *  The rows are those of the entities of the pool; in server mode, they are zeroed after each run.
+ *
+ *  \param fp stream where the statistics are printed
+ *  \param sh pointer to shared memory region
+ */
+static void printSemStats (FILE *fp, SHARED_DATA *sh)
+{
+    static const char *entity[] = {"receptionist", "waiters", "chefs", "groups"};
+    unsigned int first[] = {POOLRECEPTIONIST, POOLWAITER(0), POOLCHEF(0), POOLGROUP(0), POOL_NU};
+    const SEM_STAT *e;
+    SEM_STAT sum;
+    char name[40];
+    unsigned int c, r, s;
+
+    fprintf (fp, "%-13s %-28s %10s %10s %14s %12s %14s %10s\n", "entity", "semaphore", "downs", "ups", "wait (us)",
+             "max (us)", "hold (us)", "syscalls");
+    for (c = 0; c < 4; c++)
+        for (s = 1; s <= SEM_NU; s++) {
+            memset (&sum, 0, sizeof (sum));
+            for (r = first[c]; r < first[c+1]; r++) {
+                e = statsEntry (r, s);
+                sum.downs += e->downs;
+                sum.ups += e->ups;
+                sum.waitTotal += e->waitTotal;
+                if (e->waitMax > sum.waitMax) sum.waitMax = e->waitMax;
+                sum.holdTotal += e->holdTotal;
+                sum.syscalls += e->syscalls;
+            }
+            if ((sum.downs == 0) && (sum.ups == 0)) continue;
+            semName (sh, s, name);
+            fprintf (fp, "%-13s %-28s %10lu %10lu %14.1f %12.1f %14.1f %10lu\n", entity[c], name, sum.downs, sum.ups,
+                     sum.waitTotal / 1000.0, sum.waitMax / 1000.0, sum.holdTotal / 1000.0, sum.syscalls);
+        }
+}
+#endif
+
+/**
+ *  \brief Sets up a run: lays out the shared region for the scenario, initializes the state, reads the times
+ *         of the groups, creates the log file and assigns the semaphore ids.
+ *
+ *  \param sh pointer to shared memory region (large enough for the scenario)
+ *  \param sc pointer to the scenario (its config file is closed)
+ *  \param run number of the run (0 for the first one)
+ *  \param logMode logging mode
+ *  \param batchOrders kitchen batch mode
+ *  \param nFic name of logging file
+ *
+ *  \return true, upon success, false, if the times of a group are missing or wrong in the config file
+ */
+static bool setupRun (SHARED_DATA *sh, SCENARIO *sc, unsigned int run, unsigned int logMode, bool batchOrders,
+                      char nFic[])
+{
+    int g;
+
+    layoutSharedData (sh, sc->nGroups, sc->nTables, sc->nWaiters, sc->nChefs, logMode);
+    sh->fSt.batchOrders = batchOrders;
+    sh->fSt.tablePolicy = (sc->policy == -1) ? POLICY_FIFO : (unsigned int) sc->policy;
+
+    /* initialize seed of the run */
+    if (sc->seedGiven) sh->seed = sc->seed;
+    else sh->seed = ((unsigned long long) time (NULL) ^ ((unsigned long long) getpid () << 32)) + run;
+
+    /* initialize the shared buffer of state records */
+    sh->log.head = sh->log.tail = 0;
+    memset (sh->log.ready, 0, sizeof (sh->log.ready));
+
+    /* initialize problem internal status */
+    for (g = 0; g < sh->fSt.nChefs; g++)
+        CHEFSTAT(&sh->fSt)[g]   = WAIT_FOR_ORDER;                     /* the chefs wait for an order */
+    for (g = 0; g < sh->fSt.nWaiters; g++)
+        WAITERSTAT(&sh->fSt)[g] = WAIT_FOR_REQUEST;                /* the waiters wait for a request */
+    sh->fSt.st.receptionistStat = WAIT_FOR_REQUEST;          /* the receptionist waits for a request */
+    for (g = 0; g < sh->fSt.nGroups; g++) {
+        GROUPSTAT(&sh->fSt)[g] = GOTOREST;                                 /* groups are initialized */
+        ASSIGNEDTABLE(&sh->fSt)[g] = -1;                                   /* groups are initialized */
+    }
+    sh->fSt.groupsWaiting=0;
+    sh->fSt.orderHead = sh->fSt.orderTail = 0;
+    sh->fSt.readyHead = sh->fSt.readyTail = 0;
+    sh->fSt.waiterQueue.head = sh->fSt.waiterQueue.tail = 0;
+    sh->fSt.receptionistQueue.head = sh->fSt.receptionistQueue.tail = 0;
+    sh->fSt.seq=0;
+    sh->sleeping = 0;
+    memset (sh->latency, 0, sizeof (sh->latency));
+    memset (&sh->tables, 0, sizeof (sh->tables));
+
+    /* load times of groups from config file */
+    if (scenarioLoad (sc, STARTTIME(&sh->fSt), EATTIME(&sh->fSt)) == -1) {
+        scenarioClose (sc);
+        return false;
+    }
+    scenarioClose (sc);
+
+    /* create log file */
+    if (logMode == LOG_TRACE)
+        createTrace (nFic, &sh->fSt, TRACERECORDS (sh->fSt.nGroups));
+    else if (logMode == LOG_DELTA)
+        createDelta (nFic, &sh->fSt, DELTAEVENTS (sh->fSt.nGroups));
+    else createLog (nFic, &sh->fSt);
+    attachLog (nFic, &sh->log);
+    saveState(nFic,&sh->fSt);
+    flushState(nFic,&sh->fSt);
+
+    /* initialize semaphore ids */
+    sh->mutex                       = MUTEX;                                /* mutual exclusion semaphore id */
+    sh->receptionistReq             = RECEPTIONISTREQ;
+    sh->receptionistRequestPossible = RECEPTIONISTREQUESTPOSSIBLE;
+    sh->waiterRequest               = WAITERREQUEST;
+    sh->waiterRequestPossible       = WAITERREQUESTPOSSIBLE;
+    sh->waitOrder                   = WAITORDER;
+    sh->receptionLock               = RECEPTIONLOCK;
+    sh->waiterLock                  = WAITERLOCK;
+    sh->kitchenLock                 = KITCHENLOCK;
+    sh->waitForTable                = WAITFORTABLE;                                 /* one per group */
+    sh->foodArrived                 = FOODARRIVED;                                  /* one per table */
+    sh->tableDone                   = TABLEDONE;                                    /* one per table */
+    sh->requestReceived             = REQUESTRECEIVED;                              /* one per table */
+    return true;
+}
+
+/**
+ *  \brief Sets the semaphores of the run to their initial values (those of the pool are kept).
+ *
+ *  The region locks are free, all the slots of the queues are enabled and every other semaphore is zero.
+ *
+ *  \param sh pointer to shared memory region
+ *  \param semgid semaphore set access identifier
+ */
+static void resetSemaphores (SHARED_DATA *sh, int semgid)
+{
+    unsigned short *val;
+
+    if ((val = calloc (SEM_NU + 1, sizeof (unsigned short))) == NULL) {
+        perror ("error on allocating the semaphore values");
+        exit (EXIT_FAILURE);
+    }
+    val[sh->mutex] = 1;                                              /* enabling access to critical region */
+    val[sh->receptionLock] = val[sh->waiterLock] = val[sh->kitchenLock] = 1;     /* enabling access to the regions */
+    val[sh->waiterRequestPossible] = REQQUEUESIZE;                        /* enabling all the slots of the queues */
+    val[sh->receptionistRequestPossible] = REQQUEUESIZE;
+    if (semSetAll (semgid, SEM_NU, val) == -1) {
+        perror ("error on setting the values of the semaphores");
+        exit (EXIT_FAILURE);
+    }
+    free (val);
+}
+
+/**
+ *  \brief Prints the latencies of the groups and the use of the tables of the run.
+ *
+ *  Unless <tt>nFicHist</tt> is -, the histograms of the run are first added to those stored in the file.
+ *
+ *  \param sh pointer to shared memory region
+ *  \param nFicHist name of histograms file
+ */
+static void printRun (SHARED_DATA *sh, const char *nFicHist)
+{
+    static const char *latName[NLATENCY] = {"time-to-table", "time-to-food", "time-to-checkout"};
+    HISTOGRAM latency[NLATENCY];                                                    /* latencies of the groups */
+    unsigned int m;
+
+    memcpy (latency, sh->latency, sizeof (latency));
+    if ((strcmp (nFicHist, "-") != 0) && (histMergeFile (nFicHist, latName, latency, NLATENCY) == -1)) {
+        perror ("error on merging the histograms file");
+        exit (EXIT_FAILURE);
+    }
+    for (m = 0; m < NLATENCY; m++)
+        histPrint (stdout, latName[m], &latency[m]);
+    printTables (stdout, sh);
+}
+
+#ifndef THREADED
+/**
+ *  \brief Gets the name of the next scenario file of the server (one per line of the standard input).
+ *
+ *  Empty lines are skipped.
+ *
+ *  \param name storage of the name
+ *  \param size size of the storage
+ *
+ *  \return true, if a name was read, false, at the end of the standard input
+ */
+static bool nextScenario (char name[], int size)
+{
+    while (fgets (name, size, stdin) != NULL) {
+        name[strcspn (name, "\r\n")] = '\0';
+        if (name[0] != '\0')
+            return true;
+    }
+    return false;
+}
+
+/**
+ *  \brief Starts the run of the entities of the pool that take part in it (server mode).
+ *
+ *  \param sh pointer to shared memory region
+ *  \param semgid semaphore set access identifier
+ *  \param all every entity of the pool is started (when they must end), not only the receptionist and the
+ *         waiters, chefs and groups of the run
+ */
+static void startRuns (SHARED_DATA *sh, int semgid, bool all)
+{
+    unsigned int first[] = {POOLRECEPTIONIST, POOLWAITER(0), POOLCHEF(0), POOLGROUP(0)};
+    int n[] = {1, sh->fSt.nWaiters, sh->fSt.nChefs, sh->fSt.nGroups};
+    unsigned int k;
+    int e;
+
+    if (all) {
+        n[1] = sh->pool.nWaiters;
+        n[2] = sh->pool.nChefs;
+        n[3] = sh->pool.nGroups;
+    }
+    for (k = 0; k < 4; k++)
+        for (e = 0; e < n[k]; e++)
+            if (semUp (semgid, sh->pool.nextRun + first[k] + (unsigned int) e) == -1) {
+                perror ("error on the up operation for semaphore access (start of run)");
+                exit (EXIT_FAILURE);
+            }
+}
+
+/**
+ *  \brief Waits for the end of the run of the entities of the pool that take part in it (server mode).
+ *
+ *  In ring mode, the buffered state records are drained while waiting.
+ *
+ *  \param sh pointer to shared memory region
+ *  \param semgid semaphore set access identifier
+ *  \param logMode logging mode
+ *  \param stallTime watchdog time (0 if disabled)
+ *  \param nFic name of logging file
+ *
+ *  \return true, if the run ended, false, if it was stalled (the report is printed on stderr)
+ */
+static bool waitRun (SHARED_DATA *sh, int semgid, unsigned int logMode, unsigned int stallTime, char nFic[])
+{
+    unsigned int left = ENT_NU;                                           /* entities that did not end the run */
+
+    while (left > 0) {
+        if (semDownTimed (semgid, sh->pool.runDone, (logMode == LOG_RING) ? LOGDRAINPERIOD : STALLPERIOD) == 0) {
+            left -= 1;
+            continue;
+        }
+        if ((errno != EAGAIN) && (errno != EINTR)) {
+            perror ("error on the down operation for semaphore access (end of run)");
+            exit (EXIT_FAILURE);
+        }
+        drainLog (nFic, &sh->fSt);
+        if ((stallTime > 0) && stalled (sh, stallTime)) {
+            printStall (stderr, sh, semgid, stallTime);
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
 /**
  *  \brief Main program.
  *
@@ -51,36 +568,158 @@
 int main (int argc, char *argv[])
 {
     char nFic[51];                                                                              /*name of logging file */
-    char nFicErr[] = "error_        ";                                                     /* base name of error files */
+    char nFicErr[] = "error_              ";                                               /* base name of error files */
     int shmid,                                                                      /* shared memory access identifier */
         semgid;                                                                     /* semaphore set access identifier */
     unsigned int  m;                                                                             /* counting variables */
     SHARED_DATA *sh;                                                                /* pointer to shared memory region */
-    int pidCH,                                                                             /* pilot process identifier */
-        pidWT,                                                                     /* hostess process identifier array */
-        pidRT,                                                                     /* hostess process identifier array */
-        pidGR[MAXGROUPS];                                                     /* passengers processes identifier array */
-    int key;                                                           /*access key to shared memory and semaphore set */
-    char num[2][12];                                                     /* numeric value conversion (up to 10 digits) */
+#ifdef THREADED
+    ENTITY *ent;                                                  /* intervening entities (groups come first) */
+#else
+    int *pid;                                             /* intervening entities process identifiers (groups come first) */
     int status,                                                                                    /* execution status */
         info;                                                                                               /* info id */
-    int g, t;
+    unsigned int run;                                                              /* number of the run (server mode) */
+    SCENARIO cap;                                                /* scenario of the first run, the capacity of the pool */
+    bool ready;                                                              /* the next run is set up */
+    char nFicServer[256];                                         /* name of scenario file read by the server */
+#endif
+#ifdef SEMSTATS
+    int statid;                                                          /* semaphore statistics block identifier */
+#endif
+    int key;                                                           /*access key to shared memory and semaphore set */
+    char num[2][12];                                                     /* numeric value conversion (up to 10 digits) */
+    int g;
+    int opt;                                                                                       /* option letter */
+    unsigned int logMode = LOG_TEXT;                                                               /* logging mode */
+    char *tinp;                                                                 /* numerical parameters test flag */
+    bool keyGiven = false;                                                        /* access key set by option */
+    bool stall = false;                                                       /* run ended by the watchdog */
+    bool batchOrders = false;                                                        /* kitchen batch mode */
+    bool server = false;                                                                       /* server mode */
+    unsigned int stallTime = STALLTIME;                                              /* watchdog time */
+    unsigned int memOpt = 0;                                                  /* options of the shared region */
+    unsigned int nSems;                                                         /* number of semaphores in the set */
+    SCENARIO opts = { .seed = 0, .seedGiven = false, .policy = -1 };            /* seed and policy set by option */
+    SCENARIO sc;                                                                           /* scenario of the run */
+    char *memName;                                                             /* name of an option of the region */
+    char *nFicHist = NULL;                                                          /* name of histograms file */
+    char *nFicConf = "config.txt";                                                    /* name of scenario file */
 
-    /* getting log file name */
-    if(argc==2) {
-        strcpy(nFic, argv[1]);
+    /* getting options and log file name */
+    while ((opt = getopt (argc, argv, "l:k:c:s:P:bH:m:W:S")) != -1) {
+        switch (opt) {
+            case 'l':
+                if (strcmp (optarg, "text") == 0) logMode = LOG_TEXT;
+                else if (strcmp (optarg, "ring") == 0) logMode = LOG_RING;
+                else if (strcmp (optarg, "trace") == 0) logMode = LOG_TRACE;
+                else if (strcmp (optarg, "defer") == 0) logMode = LOG_DEFER;
+                else if (strcmp (optarg, "delta") == 0) logMode = LOG_DELTA;
+                else {
+                    fprintf (stderr, "Unknown logging mode %s!\n", optarg);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'k':
+                key = (int) strtol (optarg, &tinp, 0);
+                if ((*tinp != '\0') || (key <= 0)) {
+                    fprintf (stderr, "Wrong access key %s!\n", optarg);
+                    exit (EXIT_FAILURE);
+                }
+                keyGiven = true;
+                break;
+            case 'c':
+                nFicConf = optarg;
+                break;
+            case 's':
+                opts.seed = strtoull (optarg, &tinp, 0);
+                if (*tinp != '\0') {
+                    fprintf (stderr, "Wrong seed %s!\n", optarg);
+                    exit (EXIT_FAILURE);
+                }
+                opts.seedGiven = true;
+                break;
+            case 'P':
+                if ((opts.policy = policyOf (optarg)) == -1) {
+                    fprintf (stderr, "Unknown table scheduling policy %s!\n", optarg);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'b':
+                batchOrders = true;
+                break;
+            case 'H':
+                nFicHist = optarg;
+                break;
+            case 'm':
+                for (memName = strtok (optarg, ","); memName != NULL; memName = strtok (NULL, ",")) {
+                    if (strcmp (memName, "huge") == 0) memOpt |= SHMEM_HUGE;
+                    else if (strcmp (memName, "prefault") == 0) memOpt |= SHMEM_PREFAULT;
+                    else if (strcmp (memName, "lock") == 0) memOpt |= SHMEM_LOCK;
+                    else {
+                        fprintf (stderr, "Unknown option of the shared region %s!\n", memName);
+                        exit (EXIT_FAILURE);
+                    }
+                }
+                break;
+            case 'W':
+                stallTime = (unsigned int) strtoul (optarg, &tinp, 0);
+                if (*tinp != '\0') {
+                    fprintf (stderr, "Wrong watchdog time %s!\n", optarg);
+                    exit (EXIT_FAILURE);
+                }
+                break;
+            case 'S':
+                server = true;
+                break;
+            default:
+                fprintf (stderr, "USAGE: %s [-l text|ring|trace|defer|delta] [-k key] [-c file|-] [-s seed] [-P fifo|sef|index] [-b] [-H file|-] [-m huge,prefault,lock] [-W seconds] [-S] [logfile]\n", argv[0]);
+                exit (EXIT_FAILURE);
+        }
+    }
+    if(optind == argc-1) {
+        strcpy(nFic, argv[optind]);
     }
     else strcpy(nFic, "");
+#if defined (THREADED) || defined (SIMCLOCK)
+    if (server) {
+        fprintf (stderr, "Server mode is not available in this build!\n");
+        exit (EXIT_FAILURE);
+    }
+#else
+    if (server && ((logMode == LOG_TRACE) || (logMode == LOG_DEFER) || (logMode == LOG_DELTA))) {
+        fprintf (stderr, "Server mode is only available in text and ring logging modes!\n");
+        exit (EXIT_FAILURE);
+    }
+    if (server) {                                        /* the first scenario sets the capacity of the pool */
+        if (!nextScenario (nFicServer, sizeof (nFicServer))) {
+            fprintf (stderr, "No scenario file given to the server!\n");
+            exit (EXIT_FAILURE);
+        }
+        nFicConf = nFicServer;
+    }
+#endif
 
     /* composing command line */
-    if ((key = ftok (".", 'a')) == -1) {
+    if (!keyGiven && ((key = ftok (".", 'a')) == -1)) {
         perror ("error on generating the key");
         exit (EXIT_FAILURE);
     }
     sprintf (num[1], "%d", key);
 
+    /* parse size of the scenario in config file */
+    sc = opts;
+    if (scenarioOpen (nFicConf, &sc) == -1)
+        exit (EXIT_FAILURE);
+    if (layoutSharedData (NULL, sc.nGroups, sc.nTables, sc.nWaiters, sc.nChefs, logMode) > UINT_MAX) {
+        fprintf (stderr, "The scenario does not fit in a shared region!\n");
+        scenarioClose (&sc);
+        exit (EXIT_FAILURE);
+    }
+
     /* creating and initializing the shared memory region and the log file */
-    if ((shmid = shmemCreate (key, sizeof (SHARED_DATA))) == -1) { 
+    if ((shmid = shmemCreateOpt (key, layoutSharedData (NULL, sc.nGroups, sc.nTables, sc.nWaiters, sc.nChefs,
+                                                        logMode), memOpt)) == -1) {
         perror ("error on creating the shared memory region");
         exit (EXIT_FAILURE);
     }
@@ -88,141 +727,256 @@ int main (int argc, char *argv[])
         perror ("error on mapping the shared region on the process address space");
         exit (EXIT_FAILURE);
     }
-
-    /* initialize random generator */
-    srandom ((unsigned int) getpid ());                                
-
-    /* initialize problem internal status */
-    sh->fSt.st.chefStat         = WAIT_FOR_ORDER;                     /* the chef waits for an order */
-    sh->fSt.st.waiterStat       = WAIT_FOR_REQUEST;                /* the waiter waits for a request */
-    sh->fSt.st.receptionistStat = WAIT_FOR_REQUEST;          /* the receptionist waits for a request */
-    for (g = 0; g < MAXGROUPS; g++) {
-        sh->fSt.st.groupStat[g] = GOTOREST;                                /* groups are initialized */
-        sh->fSt.assignedTable[g] = -1;                                     /* groups are initialized */
+    if (shmemPrefault (shmid, sh, memOpt) == -1) {                  /* before the region is initialized */
+        perror ("error on pre-faulting the shared region");
+        shmemDestroy (shmid);
+        exit (EXIT_FAILURE);
     }
-    sh->fSt.groupsWaiting=0;
-
-    FILE *fp = fopen("config.txt","r");
-    if(fp==NULL) {
-        perror("Could not open config file");
-        exit(EXIT_FAILURE);
+    sh->memOpt = memOpt;
+    sh->pool = (ENTITY_POOL) { .server = server, .quit = false, .nWaiters = sc.nWaiters, .nChefs = sc.nChefs,
+                               .nGroups = sc.nGroups };
+#ifndef THREADED
+    cap = sc;
+#endif
+    if (!setupRun (sh, &sc, 0, logMode, batchOrders, nFic)) {      /* the times are wrong: no region is left */
+        shmemDettach (sh);
+        shmemDestroy (shmid);
+        exit (EXIT_FAILURE);
     }
 
-    /* parse config file */
-    fscanf(fp,"%*[^\n]");
-    fscanf(fp,"%d ",&sh->fSt.nGroups);
-    fscanf(fp,"%*[^\n]");
-    for(g=0;g < sh->fSt.nGroups;g++) {
-       fscanf(fp,"%d %d", &sh->fSt.startTime[g], &sh->fSt.eatTime[g]);
+    /* creating and initializing the semaphore set (in server mode, followed by those of the pool) */
+    nSems = SEM_NU;
+    if (server) {
+        sh->pool.runDone = nSems + 1;
+        sh->pool.nextRun = nSems + 2;
+        nSems += 1 + POOL_NU;
     }
-   
-    /* create log file */
-    createLog (nFic, &sh->fSt);                                  
-    saveState(nFic,&sh->fSt);
-
-    /* initialize semaphore ids */
-    sh->mutex                       = MUTEX;                                /* mutual exclusion semaphore id */
-    sh->receptionistReq             = RECEPTIONISTREQ;                                                      
-    sh->receptionistRequestPossible = RECEPTIONISTREQUESTPOSSIBLE;                                                      
-    sh->waiterRequest               = WAITERREQUEST;                                                      
-    sh->waiterRequestPossible       = WAITERREQUESTPOSSIBLE;                                                      
-    sh->waitOrder                   = WAITORDER;                                                      
-    sh->orderReceived               = ORDERRECEIVED;                                                      
-    for(g=0;g<sh->fSt.nGroups;g++) {
-       sh->waitForTable[g]          = WAITFORTABLE+g;                                                      
-    }
-    for(t=0;t<NUMTABLES;t++) {
-       sh->foodArrived[t]           = FOODARRIVED+t;                                                      
-       sh->tableDone[t]             = TABLEDONE+t;                                                      
-       sh->requestReceived[t]       = REQUESTRECEIVED+t;                              
-    }
-
-    /* creating and initializing the semaphore set */
-    if ((semgid = semCreate (key, SEM_NU)) == -1) { 
+    if ((semgid = semCreate (key, nSems)) == -1) { 
         perror ("error on creating the semaphore set");
         exit (EXIT_FAILURE);
     }
-    if (semUp (semgid, sh->mutex) == -1) {                   /* enabling access to critical region */
-        perror ("error on executing the up operation for semaphore access");
+#ifdef SEMSTATS
+    if ((statid = statsCreate (key, POOL_NU, nSems)) == -1) {
+        perror ("error on creating the semaphore statistics");
         exit (EXIT_FAILURE);
     }
-    if (semUp (semgid, sh->waiterRequestPossible) == -1) {                   /* enabling access to critical region */
-        perror ("error on executing the up operation for semaphore access");
+#endif
+    resetSemaphores (sh, semgid);
+
+#ifdef THREADED
+    /* generation of intervening entities threads */
+    if ((ent = malloc (ENT_NU * sizeof (ENTITY))) == NULL) {
+        perror ("error on allocating the entity array");
         exit (EXIT_FAILURE);
     }
-    if (semUp (semgid, sh->receptionistRequestPossible) == -1) {                   /* enabling access to critical region */
-        perror ("error on executing the up operation for semaphore access");
-        exit (EXIT_FAILURE);
+    strcpy (nFicErr + 6, "GR");
+    for (g = 0; g < sh->fSt.nGroups; g++) {
+        sprintf(num[0],"%d",g);
+        sprintf(nFicErr+8,"%02d",g); 
+        startEntity (&ent[g], groupMain, 5, (char *[]) {GROUP, num[0], nFic, num[1], nFicErr});
     }
-
+    strcpy (nFicErr + 6, "WT");
+    for (m = 0; m < sh->fSt.nWaiters; m++) {
+        sprintf(num[0],"%u",m);
+        if (sh->fSt.nWaiters > 1) sprintf(nFicErr+8,"%02u",m);
+        startEntity (&ent[g++], waiterMain, 5, (char *[]) {WAITER, num[0], nFic, num[1], nFicErr});
+    }
+    strcpy (nFicErr + 6, "CH");
+    for (m = 0; m < sh->fSt.nChefs; m++) {
+        sprintf(num[0],"%u",m);
+        if (sh->fSt.nChefs > 1) sprintf(nFicErr+8,"%02u",m);
+        startEntity (&ent[g++], chefMain, 5, (char *[]) {CHEF, num[0], nFic, num[1], nFicErr});
+    }
+    strcpy (nFicErr + 6, "RT");
+    startEntity (&ent[g++], receptionistMain, 4, (char *[]) {RECEPTIONIST, nFic, num[1], nFicErr});
+#else
     /* generation of intervening entities processes */          //aqui sao lançados as entidades intervenientes                     
     /* group processes */
     strcpy (nFicErr + 6, "GR");
+    if ((pid = malloc (POOL_NU * sizeof (int))) == NULL) {
+        perror ("error on allocating the process identifier array");
+        exit (EXIT_FAILURE);
+    }
     for (g = 0; g < sh->fSt.nGroups; g++) {           
-        if ((pidGR[g] = fork ()) < 0) {
+        if ((pid[g] = fork ()) < 0) {
             perror ("error on the fork operation for the group");
             exit (EXIT_FAILURE);
         }
         sprintf(num[0],"%d",g);
         sprintf(nFicErr+8,"%02d",g); 
-        if (pidGR[g] == 0)
+        if (pid[g] == 0)
             if (execl (GROUP, GROUP, num[0], nFic, num[1], nFicErr, NULL) < 0) { 
                 perror ("error on the generation of the group process");
                 exit (EXIT_FAILURE);
             }
     }
-    /* waiter process */
+    /* waiter processes */
     strcpy (nFicErr + 6, "WT");
-    if ((pidWT = fork ()) < 0)  {                            
-        perror ("error on the fork operation for the waiter");
-        exit (EXIT_FAILURE);
-    }
-    if (pidWT == 0) {
-        if (execl (WAITER, WAITER, nFic, num[1], nFicErr, NULL) < 0) {
-            perror ("error on the generation of the waiter process");
+    for (m = 0; m < sh->fSt.nWaiters; m++) {
+        if ((pid[g] = fork ()) < 0)  {                            
+            perror ("error on the fork operation for the waiter");
             exit (EXIT_FAILURE);
         }
+        sprintf(num[0],"%u",m);
+        if (sh->fSt.nWaiters > 1) sprintf(nFicErr+8,"%02u",m);
+        if (pid[g++] == 0) {
+            if (execl (WAITER, WAITER, num[0], nFic, num[1], nFicErr, NULL) < 0) {
+                perror ("error on the generation of the waiter process");
+                exit (EXIT_FAILURE);
+            }
+        }
     }
-    /* chef process */
+    /* chef processes */
     strcpy (nFicErr + 6, "CH");
-    if ((pidCH = fork ()) < 0) {               
-        perror ("error on the fork operation for the chef");
-        exit (EXIT_FAILURE);
-    }
-    if (pidCH == 0)
-        if (execl (CHEF, CHEF, nFic, num[1], nFicErr, NULL) < 0) { 
-            perror ("error on the generation of the chef process");
+    for (m = 0; m < sh->fSt.nChefs; m++) {
+        if ((pid[g] = fork ()) < 0) {               
+            perror ("error on the fork operation for the chef");
             exit (EXIT_FAILURE);
         }
+        sprintf(num[0],"%u",m);
+        if (sh->fSt.nChefs > 1) sprintf(nFicErr+8,"%02u",m);
+        if (pid[g++] == 0)
+            if (execl (CHEF, CHEF, num[0], nFic, num[1], nFicErr, NULL) < 0) { 
+                perror ("error on the generation of the chef process");
+                exit (EXIT_FAILURE);
+            }
+    }
 
     /* receptionist process */
     strcpy (nFicErr + 6, "RT");
-    if ((pidRT = fork ()) < 0) {               
+    if ((pid[g] = fork ()) < 0) {               
         perror ("error on the fork operation for the chef");
         exit (EXIT_FAILURE);
     }
-    if (pidRT == 0)
+    if (pid[g] == 0)
         if (execl (RECEPTIONIST, RECEPTIONIST, nFic, num[1], nFicErr, NULL) < 0) { 
             perror ("error on the generation of the receptionist process");
             exit (EXIT_FAILURE);
         }
 
+#endif
+
     /* signaling start of operations */
+    if (simEntities (semgid, ENT_NU) == -1) {
+        perror ("error on setting the number of intervening entities");
+        exit (EXIT_FAILURE);
+    }
     if (semSignal (semgid) == -1) {
         perror ("error on signaling start of operations");
         exit (EXIT_FAILURE);
     }
 
+#ifdef THREADED
+    /* waiting for the termination of the intervening entities threads */
+    /* in ring mode, the buffered state records are drained while waiting */
+    /* the threads of a stalled run cannot be terminated on their own, so the whole program ends */
+    while (((logMode == LOG_RING) || (stallTime > 0)) && (__atomic_load_n (&nDone, __ATOMIC_ACQUIRE) < ENT_NU)) {
+        drainLog (nFic, &sh->fSt);
+        if ((stallTime > 0) && stalled (sh, stallTime)) {
+            printStall (stderr, sh, semgid, stallTime);
+            closeTrace (nFic);
+            sortLog (nFic);
+            exit (STALLEXIT);
+        }
+        usleep ((logMode == LOG_RING) ? LOGDRAINPERIOD : STALLPERIOD);
+    }
+    for (m = 0; m < ENT_NU; m++) {
+        if ((errno = pthread_join (ent[m].thread, NULL)) != 0) {
+            perror ("error on waiting for an intervening thread");
+            exit (EXIT_FAILURE);
+        }
+    }
+    free (ent);
+#else
+    /* in server mode, the pool carries out a run for each scenario read from the standard input that fits in it */
+    /* the processes of a stalled run are terminated and the server ends */
+    for (run = 0; server; run++) {
+        startRuns (sh, semgid, false);
+        if (!waitRun (sh, semgid, logMode, stallTime, nFic)) {
+            for (g = 0; g < POOL_NU; g++)
+                kill (pid[g], SIGKILL);
+            while (wait (NULL) != -1);
+            stall = true;
+            break;
+        }
+        drainLog (nFic, &sh->fSt);
+        printf ("run %u %s groups=%d tables=%d waiters=%d chefs=%d seed=%llu\n", run, nFicServer, sh->fSt.nGroups,
+                sh->fSt.nTables, sh->fSt.nWaiters, sh->fSt.nChefs, sh->seed);
+        if (nFicHist != NULL)
+            printRun (sh, nFicHist);
+#ifdef SEMSTATS
+        printSemStats (stdout, sh);
+        if (statsClear () == -1) {
+            perror ("error on zeroing the semaphore statistics");
+            exit (EXIT_FAILURE);
+        }
+#endif
+        fflush (stdout);
+
+        ready = false;
+        while (!ready && nextScenario (nFicServer, sizeof (nFicServer))) {
+            sc = opts;
+            if (strcmp (nFicServer, "-") == 0)
+                fprintf (stderr, "The server reads the names of the scenario files from the standard input!\n");
+            else if (scenarioOpen (nFicServer, &sc) == 0) {
+                if ((sc.nGroups > cap.nGroups) || (sc.nTables > cap.nTables) || (sc.nWaiters > cap.nWaiters) ||
+                    (sc.nChefs > cap.nChefs)) {
+                    fprintf (stderr, "Scenario %s does not fit in the pool set by the first one!\n", nFicServer);
+                    scenarioClose (&sc);
+                }
+                else ready = setupRun (sh, &sc, run + 1, logMode, batchOrders, nFic);
+            }
+        }
+        if (!ready) {                                                  /* no scenario left: the pool ends */
+            __atomic_store_n (&sh->pool.quit, true, __ATOMIC_RELEASE);
+            startRuns (sh, semgid, true);
+            break;
+        }
+        resetSemaphores (sh, semgid);
+    }
+
     /* waiting for the termination of the intervening entities processes */
-    m = 0;
-    do {
-        info = wait (&status);
+    /* in ring mode, the buffered state records are drained while waiting */
+    /* the processes of a stalled run are terminated */
+    m = stall ? POOL_NU : 0;
+    while (m < POOL_NU) {
+        info = waitpid (-1, &status, ((logMode == LOG_RING) || (stallTime > 0)) ? WNOHANG : 0);
         if (info == -1) { 
             perror ("error on aiting for an intervening process");
             exit (EXIT_FAILURE);
         }
-        m += 1;
-    } while (m < 3+sh->fSt.nGroups);
+        if (info == 0) {
+            drainLog (nFic, &sh->fSt);
+            if ((stallTime > 0) && stalled (sh, stallTime)) {
+                printStall (stderr, sh, semgid, stallTime);
+                for (g = 0; g < POOL_NU; g++)
+                    kill (pid[g], SIGKILL);
+                while (wait (NULL) != -1);
+                stall = true;
+                break;
+            }
+            usleep ((logMode == LOG_RING) ? LOGDRAINPERIOD : STALLPERIOD);
+        }
+        else m += 1;
+    }
+    free (pid);
+#endif
+    drainLog (nFic, &sh->fSt);
+    closeTrace (nFic);
+    sortLog (nFic);
+
+    /* printing the latencies of the groups (those of a stalled run are left out of the histograms file) */
+    /* in server mode they were printed at the end of each run */
+    if ((nFicHist != NULL) && !stall && !server)
+        printRun (sh, nFicHist);
+#ifdef SEMSTATS
+    if (!server || stall)
+        printSemStats (stdout, sh);
+    if (statsDestroy (statid) == -1) {
+        perror ("error on destructing the semaphore statistics");
+        exit (EXIT_FAILURE);
+    }
+#endif
 
     /* destruction of semaphore set and shared region */
     if (semDestroy (semgid) == -1) {
@@ -238,5 +992,5 @@ int main (int argc, char *argv[])
         exit (EXIT_FAILURE);
     }
 
-    return EXIT_SUCCESS;
+    return stall ? STALLEXIT : EXIT_SUCCESS;
 }
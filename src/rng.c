@@ -0,0 +1,114 @@
+/**
+ *  \file rng.c (implementation file)
+ *
+ *  \brief Random number generation.
+ *
+ *  Defined operations:
+ *     \li seeding of a generator for a stream of a run
+ *     \li generation of a 64-bit value
+ *     \li generation of a uniform value in [0, 1)
+ *     \li generation of a standard normal value.
+ *
+ *  The state of a stream is filled by splitmix64 from the seed of the run mixed with the number of
+ *  the stream, as recommended by the authors of xoshiro256**.
+ */
+
+#include <math.h>
+
+#include "rng.h"
+
+/* internal functions */
+
+static unsigned long long splitmix (unsigned long long *x)
+{
+    unsigned long long z = (*x += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static unsigned long long rotl (unsigned long long x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/**
+ *  \brief Seeding of a generator for a stream of a run.
+ *
+ *  \param r pointer to the generator
+ *  \param seed seed of the run
+ *  \param stream number of the stream (the entity that draws from it)
+ */
+void rngSeed (RNG *r, unsigned long long seed, unsigned int stream)
+{
+    unsigned long long x = seed;
+    unsigned int k;
+
+    x = splitmix (&x) ^ ((unsigned long long) stream * 0xd1b54a32d192ed03ULL);
+    for (k = 0; k < 4; k++)
+        r->s[k] = splitmix (&x);
+    r->hasSpare = false;
+}
+
+/**
+ *  \brief Generation of a 64-bit value.
+ *
+ *  \param r pointer to the generator
+ *
+ *  \return uniform value in [0, 2^64)
+ */
+unsigned long long rngNext (RNG *r)
+{
+    unsigned long long *s = r->s,
+                       v = rotl (s[1] * 5, 7) * 9,
+                       t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl (s[3], 45);
+    return v;
+}
+
+/**
+ *  \brief Generation of a uniform value in [0, 1).
+ *
+ *  \param r pointer to the generator
+ *
+ *  \return value with 53 random bits
+ */
+double rngUniform (RNG *r)
+{
+    return (rngNext (r) >> 11) * 0x1.0p-53;
+}
+
+/**
+ *  \brief Generation of a standard normal value (Marsaglia's polar form of Box-Muller).
+ *
+ *  The values are generated in pairs; the second one is returned by the next call.
+ *
+ *  \param r pointer to the generator
+ *
+ *  \return value with zero mean and unit standard deviation
+ */
+double rngNormal (RNG *r)
+{
+    double u, v, q;
+
+    if (r->hasSpare) {
+        r->hasSpare = false;
+        return r->spare;
+    }
+    do {                                                 /* a point in the unit circle, but the origin */
+        u = 2.0 * rngUniform (r) - 1.0;
+        v = 2.0 * rngUniform (r) - 1.0;
+        q = u * u + v * v;
+    } while ((q >= 1.0) || (q == 0.0));
+    q = sqrt (-2.0 * log (q) / q);
+    r->spare = v * q;
+    r->hasSpare = true;
+    return u * q;
+}
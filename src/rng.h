@@ -0,0 +1,73 @@
+/**
+ *  \file rng.h (interface file)
+ *
+ *  \brief Random number generation.
+ *
+ *  Defined operations:
+ *     \li seeding of a generator for a stream of a run
+ *     \li generation of a 64-bit value
+ *     \li generation of a uniform value in [0, 1)
+ *     \li generation of a standard normal value.
+ *
+ *  The generator is xoshiro256** (Blackman and Vigna), whose state is held by the caller, so every
+ *  entity draws from a stream of its own without locks (random keeps a single state, shared by the
+ *  threads of a process). The streams of a run are derived from its seed and the number of the stream,
+ *  so the same seed always gives the same values to the same entity.
+ */
+
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <stdbool.h>
+
+/**
+ *  \brief Definition of the state of a generator.
+ */
+typedef struct {
+    /** \brief state of xoshiro256** */
+    unsigned long long s[4];
+    /** \brief second value of the last pair of normal values */
+    double spare;
+    /** \brief the spare value was not returned yet */
+    bool hasSpare;
+} RNG;
+
+/**
+ *  \brief Seeding of a generator for a stream of a run.
+ *
+ *  \param r pointer to the generator
+ *  \param seed seed of the run
+ *  \param stream number of the stream (the entity that draws from it)
+ */
+extern void rngSeed (RNG *r, unsigned long long seed, unsigned int stream);
+
+/**
+ *  \brief Generation of a 64-bit value.
+ *
+ *  \param r pointer to the generator
+ *
+ *  \return uniform value in [0, 2^64)
+ */
+extern unsigned long long rngNext (RNG *r);
+
+/**
+ *  \brief Generation of a uniform value in [0, 1).
+ *
+ *  \param r pointer to the generator
+ *
+ *  \return value with 53 random bits
+ */
+extern double rngUniform (RNG *r);
+
+/**
+ *  \brief Generation of a standard normal value (Marsaglia's polar form of Box-Muller).
+ *
+ *  The values are generated in pairs; the second one is returned by the next call.
+ *
+ *  \param r pointer to the generator
+ *
+ *  \return value with zero mean and unit standard deviation
+ */
+extern double rngNormal (RNG *r);
+
+#endif /* RNG_H_ */
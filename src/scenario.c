@@ -0,0 +1,393 @@
+/**
+ *  \file scenario.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Loading of scenario files.
+ *
+ *  Defined operations:
+ *     \li opening of a scenario file and parsing of its sizes
+ *     \li loading of the times of the groups
+ *     \li closing of a scenario file
+ *     \li lookup of a table scheduling policy by name.
+ *
+ *  The numbers of a text file are read by a scanner of its own over the contents in memory, which
+ *  checks their range as it goes, instead of by fscanf, which neither reports an overflow nor needs
+ *  the file to be read through the buffers of stdio.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "probConst.h"
+#include "scenario.h"
+
+/** \brief size of the blocks the standard input is read in */
+#define  READCHUNK      (1 << 16)
+
+const char *policyName[] = {"fifo", "sef", "index", NULL};
+
+/** \brief number of table scheduling policies */
+#define  NPOLICIES      ((int) (sizeof (policyName) / sizeof (policyName[0])) - 1)
+
+/**
+ *  \brief Definition of the position of the scanner of a text file.
+ */
+typedef struct {
+    /** \brief start of the contents */
+    const char *start;
+    /** \brief next character */
+    const char *p;
+    /** \brief end of the contents */
+    const char *end;
+    /** \brief name of the file */
+    const char *nFic;
+} SCANNER;
+
+/* internal functions */
+
+static bool isSpace (char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') || (c == '\f') || (c == '\v');
+}
+
+static void skipSpace (SCANNER *s)
+{
+    while ((s->p < s->end) && isSpace (*s->p))
+        s->p += 1;
+}
+
+static void skipLine (SCANNER *s)
+{
+    const char *nl = memchr (s->p, '\n', (size_t) (s->end - s->p));
+
+    s->p = (nl == NULL) ? s->end : nl + 1;
+}
+
+/**
+ *  \brief reports an error at the position of the scanner (the message is formatted as by printf).
+ *
+ *  \return -1
+ */
+static int wrong (const SCANNER *s, const char *what, ...)
+{
+    const char *c;
+    unsigned int line = 1;
+    va_list ap;
+
+    for (c = s->start; c < s->p; c++)                             /* only counted when there is an error */
+        if (*c == '\n') line += 1;
+    fprintf (stderr, "%s:%u: ", s->nFic, line);
+    va_start (ap, what);
+    vfprintf (stderr, what, ap);
+    va_end (ap);
+    fprintf (stderr, "!\n");
+    return -1;
+}
+
+/**
+ *  \brief scans a non-negative integer, after white space.
+ *
+ *  \param s pointer to the scanner
+ *  \param max largest value accepted
+ *  \param v pointer to the value
+ *
+ *  \return true, upon success, false, if there are no digits, they are followed by other characters
+ *          than white space or the value is larger than max
+ */
+static bool scanNumber (SCANNER *s, unsigned long long max, unsigned long long *v)
+{
+    const char *first;
+    unsigned long long n = 0;
+    unsigned int d;
+
+    skipSpace (s);
+    if ((s->p < s->end) && (*s->p == '+'))
+        s->p += 1;
+    for (first = s->p; (s->p < s->end) && ((d = (unsigned int) (*s->p - '0')) <= 9); s->p++) {
+        if (n > (max - d) / 10)
+            return false;
+        n = 10 * n + d;
+    }
+    if ((s->p == first) || ((s->p < s->end) && !isSpace (*s->p)))
+        return false;
+    *v = n;
+    return true;
+}
+
+/**
+ *  \brief scans a count (a positive int) on the line that follows a header line.
+ */
+static bool scanCount (SCANNER *s, int *count)
+{
+    unsigned long long v;
+
+    if (!scanNumber (s, INT_MAX, &v) || (v == 0))
+        return false;
+    *count = (int) v;
+    return true;
+}
+
+/**
+ *  \brief tests if the next line is a given header line and, if so, skips it.
+ */
+static bool isHeader (SCANNER *s, const char *name)
+{
+    size_t len = strlen (name);
+
+    if (((size_t) (s->end - s->p) < len) || (memcmp (s->p, name, len) != 0))
+        return false;
+    skipLine (s);
+    return true;
+}
+
+/**
+ *  \brief parses the sizes of a text file, up to the times of the groups.
+ */
+static int parseText (SCENARIO *sc, SCANNER *s)
+{
+    unsigned long long v;
+    const char *word;
+    char name[16];
+    size_t len;
+
+    skipLine (s);                                                                      /* #ngroups */
+    if (!scanCount (s, &sc->nGroups))
+        return wrong (s, "wrong number of groups");
+    while (true) {
+        skipSpace (s);
+        if ((s->p == s->end) || (*s->p != '#'))
+            break;
+        if (isHeader (s, "#ntables")) {
+            if (!scanCount (s, &sc->nTables)) return wrong (s, "wrong number of tables");
+        }
+        else if (isHeader (s, "#nwaiters")) {
+            if (!scanCount (s, &sc->nWaiters)) return wrong (s, "wrong number of waiters");
+        }
+        else if (isHeader (s, "#nchefs")) {
+            if (!scanCount (s, &sc->nChefs)) return wrong (s, "wrong number of chefs");
+        }
+        else if (isHeader (s, "#seed")) {
+            if (!scanNumber (s, ULLONG_MAX, &v)) return wrong (s, "wrong seed");
+            if (!sc->seedGiven) {                                        /* the option takes precedence */
+                sc->seed = v;
+                sc->seedGiven = true;
+            }
+        }
+        else if (isHeader (s, "#policy")) {
+            skipSpace (s);
+            for (word = s->p; (s->p < s->end) && !isSpace (*s->p); s->p++);
+            len = (size_t) (s->p - word);
+            if (len >= sizeof (name)) len = sizeof (name) - 1;
+            memcpy (name, word, len);
+            name[len] = '\0';
+            if (policyOf (name) == -1) return wrong (s, "unknown table scheduling policy");
+            if (sc->policy == -1) sc->policy = policyOf (name);          /* the option takes precedence */
+        }
+        else {                                                 /* the header of the times of the groups */
+            skipLine (s);
+            break;
+        }
+    }
+    sc->times = (size_t) (s->p - s->start);
+    return 0;
+}
+
+/**
+ *  \brief parses the header of a compiled scenario.
+ */
+static int parseBinary (SCENARIO *sc, const char *nFic)
+{
+    SCENARIO_HEADER hdr;
+
+    if (sc->size < sizeof (hdr)) {
+        fprintf (stderr, "%s: truncated compiled scenario!\n", nFic);
+        return -1;
+    }
+    memcpy (&hdr, sc->data, sizeof (hdr));
+    if (hdr.version != SCENVERSION) {
+        fprintf (stderr, "%s: version %u of the compiled scenario format is not supported!\n", nFic, hdr.version);
+        return -1;
+    }
+    if ((hdr.nGroups < 1) || (hdr.nTables < 1) || (hdr.nWaiters < 1) || (hdr.nChefs < 1)) {
+        fprintf (stderr, "%s: wrong number of groups, tables, waiters or chefs!\n", nFic);
+        return -1;
+    }
+    if ((hdr.policy < -1) || (hdr.policy >= NPOLICIES)) {
+        fprintf (stderr, "%s: unknown table scheduling policy %d!\n", nFic, hdr.policy);
+        return -1;
+    }
+    if (sc->size != sizeof (hdr) + 2 * (size_t) hdr.nGroups * sizeof (int32_t)) {
+        fprintf (stderr, "%s: the compiled scenario does not hold the times of %d groups!\n", nFic, hdr.nGroups);
+        return -1;
+    }
+    sc->nGroups = hdr.nGroups;
+    sc->nTables = hdr.nTables;
+    sc->nWaiters = hdr.nWaiters;
+    sc->nChefs = hdr.nChefs;
+    if (!sc->seedGiven && hdr.seedGiven) {                               /* the option takes precedence */
+        sc->seed = hdr.seed;
+        sc->seedGiven = true;
+    }
+    if (sc->policy == -1) sc->policy = hdr.policy;
+    sc->times = sizeof (hdr);
+    return 0;
+}
+
+/**
+ *  \brief reads the standard input into a buffer.
+ *
+ *  \return 0, upon success, -1, otherwise
+ */
+static int readInput (SCENARIO *sc)
+{
+    char *buf = NULL, *nbuf;
+    size_t cap = 0, size = 0;
+    ssize_t n;
+
+    do {
+        if (cap - size < READCHUNK) {
+            cap = (cap == 0) ? 4 * READCHUNK : 2 * cap;
+            if ((nbuf = realloc (buf, cap)) == NULL) {
+                free (buf);
+                return -1;
+            }
+            buf = nbuf;
+        }
+        if ((n = read (STDIN_FILENO, buf + size, cap - size)) > 0)
+            size += (size_t) n;
+    } while (n > 0);
+    if (n == -1) {
+        free (buf);
+        return -1;
+    }
+    sc->data = buf;
+    sc->size = size;
+    sc->mapped = false;
+    return 0;
+}
+
+/**
+ *  \brief maps a file in memory.
+ *
+ *  \return 0, upon success, -1, otherwise
+ */
+static int mapInput (SCENARIO *sc, const char *nFic)
+{
+    struct stat st;
+    void *add;
+    int fd;
+
+    if ((fd = open (nFic, O_RDONLY)) == -1)
+        return -1;
+    if (fstat (fd, &st) == -1) {
+        close (fd);
+        return -1;
+    }
+    sc->size = (size_t) st.st_size;
+    sc->mapped = true;
+    if (sc->size == 0)                                                       /* an empty file cannot be mapped */
+        sc->data = "";
+    else if ((add = mmap (NULL, sc->size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close (fd);
+        return -1;
+    }
+    else {
+        sc->data = add;
+        madvise (add, sc->size, MADV_SEQUENTIAL);                              /* it is read only once */
+    }
+    close (fd);
+    return 0;
+}
+
+/* external functions */
+
+int policyOf (const char *name)
+{
+    int p;
+
+    for (p = 0; policyName[p] != NULL; p++)
+        if (strcmp (name, policyName[p]) == 0)
+            return p;
+    return -1;
+}
+
+int scenarioOpen (const char *nFic, SCENARIO *sc)
+{
+    SCANNER s;
+    long long nSems;
+    int stat;
+
+    sc->nTables = NUMTABLES;
+    sc->nWaiters = sc->nChefs = 1;
+    sc->data = NULL;
+    sc->nFic = nFic;
+    if (((strcmp (nFic, "-") == 0) ? readInput (sc) : mapInput (sc, nFic)) == -1) {
+        perror ("Could not read config file");
+        return -1;
+    }
+    sc->binary = (sc->size >= sizeof (SCENMAGIC) - 1) && (memcmp (sc->data, SCENMAGIC, sizeof (SCENMAGIC) - 1) == 0);
+    if (sc->binary)
+        stat = parseBinary (sc, nFic);
+    else {
+        s = (SCANNER) { .start = sc->data, .p = sc->data, .end = sc->data + sc->size, .nFic = nFic };
+        stat = parseText (sc, &s);
+    }
+
+    /* the semaphores of the run and the pool of server mode, as numbered by SEM_NU and POOL_NU */
+    if (stat == 0) {
+        nSems = 9 + 2LL * sc->nGroups + 3LL * sc->nTables + 3 + sc->nWaiters + sc->nChefs;
+        if (nSems > INT_MAX) {
+            fprintf (stderr, "%s: too many groups, tables, waiters or chefs!\n", nFic);
+            stat = -1;
+        }
+    }
+    if (stat == -1)
+        scenarioClose (sc);
+    return stat;
+}
+
+int scenarioLoad (SCENARIO *sc, int startTime[], int eatTime[])
+{
+    SCANNER s = { .start = sc->data, .p = sc->data + sc->times, .end = sc->data + sc->size, .nFic = sc->nFic };
+    unsigned long long st, et;
+    size_t n = (size_t) sc->nGroups;
+    int g;
+
+    if (sc->binary) {                                          /* the arrays are copied as they are */
+        memcpy (startTime, sc->data + sc->times, n * sizeof (int));
+        memcpy (eatTime, sc->data + sc->times + n * sizeof (int), n * sizeof (int));
+        for (g = 0; g < sc->nGroups; g++)
+            if ((startTime[g] < 0) || (eatTime[g] < 0)) {
+                fprintf (stderr, "%s: wrong times of group %d!\n", sc->nFic, g);
+                return -1;
+            }
+        return 0;
+    }
+    for (g = 0; g < sc->nGroups; g++) {
+        if (!scanNumber (&s, INT_MAX, &st) || !scanNumber (&s, INT_MAX, &et)) {
+            skipSpace (&s);
+            return wrong (&s, (s.p == s.end) ? "times of group %d missing" : "wrong times of group %d", g);
+        }
+        startTime[g] = (int) st;
+        eatTime[g] = (int) et;
+    }
+    return 0;
+}
+
+void scenarioClose (SCENARIO *sc)
+{
+    if (sc->data == NULL)
+        return;
+    if (!sc->mapped) free ((void *) sc->data);
+    else if (sc->size != 0) munmap ((void *) sc->data, sc->size);
+    sc->data = NULL;
+}
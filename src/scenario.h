@@ -0,0 +1,142 @@
+/**
+ *  \file scenario.h (interface file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Loading of scenario files.
+ *
+ *  Defined operations:
+ *     \li opening of a scenario file and parsing of its sizes
+ *     \li loading of the times of the groups
+ *     \li closing of a scenario file
+ *     \li lookup of a table scheduling policy by name.
+ *
+ *  A scenario file is either a text file in the format of config.txt or a compiled scenario (see
+ *  genScenario -B): a SCENARIO_HEADER followed by the start times and by the eat times of the groups, as
+ *  arrays of 32-bit integers in the byte order of the host, which are copied as they are into the shared
+ *  region. The file is mapped in memory and parsed in a single pass, without stdio; the standard input,
+ *  which may be a pipe, is read into a buffer first. The sizes are checked against the limits of the
+ *  simulation before the shared region is created, and the times when they are loaded.
+ */
+
+#ifndef SCENARIO_H_
+#define SCENARIO_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** \brief magic number of a compiled scenario */
+#define  SCENMAGIC        "RSCN"
+
+/** \brief version of the format of a compiled scenario */
+#define  SCENVERSION      1
+
+/**
+ *  \brief Definition of the header of a compiled scenario.
+ */
+typedef struct {
+    /** \brief magic number (SCENMAGIC, without the terminating null) */
+    char magic[4];
+    /** \brief version of the format (SCENVERSION) */
+    uint32_t version;
+    /** \brief number of groups */
+    int32_t nGroups;
+    /** \brief number of tables */
+    int32_t nTables;
+    /** \brief number of waiters */
+    int32_t nWaiters;
+    /** \brief number of chefs */
+    int32_t nChefs;
+    /** \brief table scheduling policy (-1 if not set) */
+    int32_t policy;
+    /** \brief the seed is set */
+    uint32_t seedGiven;
+    /** \brief seed of the run */
+    uint64_t seed;
+} SCENARIO_HEADER;
+
+/**
+ *  \brief Definition of a scenario, as given by its file.
+ */
+typedef struct {
+    /** \brief number of groups */
+    int nGroups;
+    /** \brief number of tables */
+    int nTables;
+    /** \brief number of waiters */
+    int nWaiters;
+    /** \brief number of chefs */
+    int nChefs;
+    /** \brief seed of the run */
+    unsigned long long seed;
+    /** \brief the seed was set (by option or by the scenario file) */
+    bool seedGiven;
+    /** \brief table scheduling policy (-1 while not set) */
+    int policy;
+    /** \brief name of the scenario file, used in the errors (it must be kept until the file is closed) */
+    const char *nFic;
+    /** \brief contents of the scenario file (NULL once it is closed) */
+    const char *data;
+    /** \brief size in bytes of the contents */
+    size_t size;
+    /** \brief the contents are mapped (not read into a buffer) */
+    bool mapped;
+    /** \brief the file is a compiled scenario */
+    bool binary;
+    /** \brief position of the times of the groups in the contents */
+    size_t times;
+} SCENARIO;
+
+/** \brief names of the table scheduling policies (the position of a name is its POLICY_ constant, NULL terminated) */
+extern const char *policyName[];
+
+/**
+ *  \brief Lookup of a table scheduling policy by name.
+ *
+ *  \param name name of the policy
+ *
+ *  \return policy (POLICY_FIFO, POLICY_SEF or POLICY_INDEX) or -1, if the name is unknown
+ */
+extern int policyOf (const char *name);
+
+/**
+ *  \brief Opening of a scenario file and parsing of its sizes.
+ *
+ *  In a text file, the first line is a header and the second one the number of groups; the #ntables,
+ *  #nwaiters, #nchefs, #seed and #policy sections follow, in any order, and are optional; the first other
+ *  line starts the times of the groups (it is skipped if it is a header line). The seed and the policy
+ *  already in the scenario (set by option) take precedence over those of the file.
+ *
+ *  The sizes must be positive and small enough for the semaphores of the scenario (those of the pool of
+ *  server mode included) to be numbered by an int. Errors are reported on stderr.
+ *
+ *  \param nFic name of the scenario file (- for the standard input)
+ *  \param sc pointer to the scenario
+ *
+ *  \return 0, upon success, -1, if the file cannot be read or its contents are wrong (the file is closed)
+ */
+extern int scenarioOpen (const char *nFic, SCENARIO *sc);
+
+/**
+ *  \brief Loading of the times of the groups.
+ *
+ *  The times must be non-negative integers that fit in an int. Errors are reported on stderr, with the
+ *  name of the file and, in a text file, the line where they are found.
+ *
+ *  \param sc pointer to the scenario (open)
+ *  \param startTime start times of the groups (nGroups entries)
+ *  \param eatTime eat times of the groups (nGroups entries)
+ *
+ *  \return 0, upon success, -1, if a time is missing or wrong
+ */
+extern int scenarioLoad (SCENARIO *sc, int startTime[], int eatTime[]);
+
+/**
+ *  \brief Closing of a scenario file.
+ *
+ *  \param sc pointer to the scenario (nothing is done if it is already closed)
+ */
+extern void scenarioClose (SCENARIO *sc);
+
+#endif /* SCENARIO_H_ */
@@ -10,6 +10,10 @@
  *     \li waitOrder
  *     \li processOrder
  *
+ *  In kitchen batch mode (option -b of the generator) a single chef takes all the pending orders at once
+ *  and cooks them together, in the time of the longest one plus BATCHCOOK for every other order; the
+ *  dishes are then handed to the waiters at once.
+ *
  *  \author Nuno Lau - December 2023
  */
 
@@ -29,61 +33,91 @@
 #include "logging.h"
 #include "sharedDataSync.h"
 #include "semaphore.h"
+#include "semStats.h"
 #include "sharedMemory.h"
+#include "simClock.h"
+#include "rng.h"
+
+#ifdef THREADED
+/** \brief storage class of the chef variables (each chef is run by its own thread) */
+#define CHEFLOCAL __thread
+#else
+/** \brief storage class of the chef variables */
+#define CHEFLOCAL
+#endif
 
 
 /** \brief logging file name */
-static char nFic[51];
+static CHEFLOCAL char nFic[51];
 
 /** \brief shared memory block access identifier */
-static int shmid;
+static CHEFLOCAL int shmid;
 
 /** \brief semaphore set access identifier */
-static int semgid;
+static CHEFLOCAL int semgid;
+
+/** \brief groups whose food is being cooked */
+static CHEFLOCAL int *cooking;
+
+/** \brief number of groups in <tt>cooking</tt> */
+static CHEFLOCAL unsigned int nCooking;
 
-/** \brief group that requested cooking food */
-static int lastGroup;
+/** \brief the last order was taken by this chef */
+static CHEFLOCAL bool lastTaken = false;
 
 /** \brief pointer to shared memory region */
-static SHARED_DATA *sh;
+static CHEFLOCAL SHARED_DATA *sh;
 
-static void waitForOrder ();
-static void processOrder ();
+/** \brief random generator of the chef */
+static CHEFLOCAL RNG rng;
+
+static bool waitForOrder (int id);
+static void processOrder (int id);
 
 /**
  *  \brief Main program.
  *
  *  Its role is to generate the life cycle of one of intervening entities in the problem: the chef.
  */
+#ifdef THREADED
+int chefMain (int argc, char *argv[])
+#else
 int main (int argc, char *argv[])
+#endif
 {
     int key;                                          /*access key to shared memory and semaphore set */
     char *tinp;                                                     /* numerical parameters test flag */
+    int n;
+    bool started = false;                                 /* the chef took part in a run */
 
     /* validation of command line parameters */
 
-    if (argc != 4) { 
+    if (argc != 5) { 
         freopen ("error_CH", "a", stderr);
         fprintf (stderr, "Number of parameters is incorrect!\n");
         return EXIT_FAILURE;
     }
     else {
-       freopen (argv[3], "w", stderr);
+#ifndef THREADED
+       freopen (argv[4], "w", stderr);
+#endif
        setbuf(stderr,NULL);
     }
-    strcpy (nFic, argv[1]);
-    key = (unsigned int) strtol (argv[2], &tinp, 0);
+    n = (unsigned int) strtol (argv[1], &tinp, 0);
+    if ((*tinp != '\0') || (n < 0)) { 
+        fprintf (stderr, "Chef process identification is wrong!\n");
+        return EXIT_FAILURE;
+    }
+    strcpy (nFic, argv[2]);
+    key = (unsigned int) strtol (argv[3], &tinp, 0);
     if (*tinp != '\0') {
         fprintf (stderr, "Error on the access key communication!\n");
         return EXIT_FAILURE;
     }
 
-    /* connection to the semaphore set and the shared memory region and mapping the shared region onto the
-       process address space */
-    if ((semgid = semConnect (key)) == -1) { 
-        perror ("error on connecting to the semaphore set");
-        return EXIT_FAILURE;
-    }
+    /* connection to the shared memory region, mapping the shared region onto the process address space and
+       connection to the semaphore set; the region is pre-faulted first, since the connection to the semaphore
+       set waits for the start of operations */
     if ((shmid = shmemConnect (key)) == -1) { 
         perror ("error on connecting to the shared memory region");
         return EXIT_FAILURE;
@@ -92,18 +126,47 @@ int main (int argc, char *argv[])
         perror ("error on mapping the shared region on the process address space");
         return EXIT_FAILURE;
     }
+    if (shmemPrefault (shmid, sh, sh->memOpt) == -1) {                  /* no page faults in the life cycle */
+        perror ("error on pre-faulting the shared region");
+        return EXIT_FAILURE;
+    }
+    if ((semgid = semConnect (key)) == -1) { 
+        perror ("error on connecting to the semaphore set");
+        return EXIT_FAILURE;
+    }
+    attachLog (nFic, &sh->log);
+    if (n >= sh->fSt.nChefs) { 
+        fprintf (stderr, "Chef process identification is wrong!\n");
+        return EXIT_FAILURE;
+    }
+    if (statsConnect (key, POOLCHEF(n)) == -1) {
+        perror ("error on connecting to the semaphore statistics");
+        return EXIT_FAILURE;
+    }
 
-    /* initialize random generator */
-    srandom ((unsigned int) getpid ());                                      
+    /* sized for the largest run (the first one) */
+    if ((cooking = malloc (sh->pool.nGroups * sizeof (int))) == NULL) {
+        perror ("error on allocating the array of orders being cooked");
+        return EXIT_FAILURE;
+    }
+
+    /* simulation of the life cycle of the chef: the chefs share the orders, until all of them are taken */
+    while (startRun (sh, semgid, POOLCHEF(n), &started)) {
+        /* initialize random generator (a stream of the seed of the run) */
+        rngSeed (&rng, sh->seed, ENTCHEF(n));
+        lastTaken = false;
 
-    /* simulation of the life cycle of the chef */
+        while(waitForOrder(n)) {
+           processOrder(n);
+        }
+    }
 
-    int nOrders=0;
-    while(nOrders < sh->fSt.nGroups) {
-       waitForOrder();
-       processOrder();
+    free (cooking);
 
-       nOrders++;
+    /* the entity does not take part in the simulation any more */
+    if (simDone (semgid) == -1) {
+        perror ("error on signaling the end of the entity");
+        exit (EXIT_FAILURE);
     }
 
     /* unmapping the shared region off the process address space */
@@ -119,85 +182,132 @@ int main (int argc, char *argv[])
 /**
  *  \brief chefs wait for a food order.
  *
- *  The chef waits for the food request that will be provided by the waiter.
+ *  The chef waits for the food request that will be provided by a waiter and takes the oldest order
+ *  not yet taken by another chef or, in kitchen batch mode with a single chef, all the pending orders.
+ *  The chef that takes the last order finishes after cooking it and wakes up the other chefs, which find
+ *  no order and finish.
  *  Updates its state and saves internal state.
- *  Received order should be acknowledged.
+ *  The waiters do not wait for the orders to be taken: the dishes ready are their completion notification.
+ *
+ *  \param id chef id
+ *
+ *  \return true, if orders were taken, false, if all the orders were already taken
  */
-static void waitForOrder()
+static bool waitForOrder(int id)
 {
-    if (semDown(semgid, sh->waitOrder) == -1)
+    SEMOP enter[] = {{ sh->waitOrder, SEMDOWN }, { sh->kitchenLock, SEMDOWN }};
+    SEMOP leave[3];
+    unsigned int nops = 0;
+    /* other chefs may have been woken up for the orders that would be taken, so only a single chef drains */
+    unsigned int max = (sh->fSt.batchOrders && (sh->fSt.nChefs == 1)) ? (unsigned int) sh->fSt.nGroups : 1;
+
+    if (lastTaken)
+        return false;
+
+    if (semOpBatch(semgid, enter, 2) == -1)     // wait for order and enter kitchen region
     {
-        perror("error on the down operation for semaphore access");
+        perror("error on the down operation for semaphore access (Chef)");
         exit(EXIT_FAILURE);
     }
 
-    if (semDown(semgid, sh->mutex) == -1)
+    if (sh->fSt.orderTail == sh->fSt.orderHead) {           // woken up by the chef that took the last order
+        if (semUp(semgid, sh->kitchenLock) == -1)   // exit kitchen region
+        {
+            perror("error on the up operation for semaphore access (Chef)");
+            exit(EXIT_FAILURE);
+        }
+        return false;
+    }
+    nCooking = 0;
+    while ((nCooking < max) && (sh->fSt.orderTail != sh->fSt.orderHead))
+        cooking[nCooking++] = ORDERGROUP(&sh->fSt)[sh->fSt.orderTail++];
+
+    if (nCooking > 1)                             // the remaining orders were already signalled by the waiters
+        leave[nops++] = (SEMOP) { sh->waitOrder, -(int) (nCooking-1) };
+    lastTaken = (sh->fSt.orderTail == (unsigned int) sh->fSt.nGroups);
+    if (lastTaken && (sh->fSt.nChefs > 1))                          // the other chefs are woken up to finish
+        leave[nops++] = (SEMOP) { sh->waitOrder, sh->fSt.nChefs-1 };
+    leave[nops++] = (SEMOP) { sh->kitchenLock, SEMUP };
+    if (semOpBatch(semgid, leave, nops) == -1)  // exit kitchen region
     {
-        perror("error on the down operation for semaphore access (Chef)");
+        perror("error on the up operation for semaphore access (Chef)");
         exit(EXIT_FAILURE);
     }
 
-    lastGroup = sh->fSt.foodGroup;
-    
-    sh->fSt.st.chefStat = COOK;
-    saveState(nFic, &sh->fSt);
-
-    if (semUp(semgid, sh->orderReceived) == -1)
+    if (semDown(semgid, sh->mutex) == -1)       // enter state region
     {
-        perror("error on the down operation for semaphore access");
+        perror("error on the down operation for semaphore access (Chef)");
         exit(EXIT_FAILURE);
     }
 
-    if (semUp(semgid, sh->mutex) == -1)
+    beginUpdate(&sh->fSt);
+    CHEFSTAT(&sh->fSt)[id] = COOK;
+    saveState(nFic, &sh->fSt);
+    endUpdate(&sh->fSt);
+
+    if (semUp(semgid, sh->mutex) == -1)         // exit state region
     {
         perror("error on the up operation for semaphore access (Chef)");
         exit(EXIT_FAILURE);
     }
+
+    flushState(nFic, &sh->fSt);
+    return true;
 }
 
+
+
 /**
  *  \brief chef cooks, then delivers the food to the waiter 
  *
- *  The chef takes some time to cook and signals the waiter that food is 
- *  ready (this may only happen when waiter is available)
+ *  The chef takes some time to cook and signals the waiters that food is 
+ *  ready (the dishes ready have a slot per group, so it never waits for groups)
  *  then updates its state.
+ *  The food of all the orders taken together is cooked at once and signalled at once.
  *  The internal state should be saved.
+ *
+ *  \param id chef id
  */
-static void processOrder()
+static void processOrder(int id)
 {
-    usleep((unsigned int)floor((MAXCOOK * random()) / RAND_MAX + 100.0));
+    SEMOP enter[] = {{ sh->waiterLock, SEMDOWN }, { sh->mutex, SEMDOWN }};
+    SEMOP leave[] = {{ sh->waiterRequest, (int) nCooking }, { sh->waiterLock, SEMUP }};
+    unsigned int cook = 0, t, n;
 
-    if (semDown(semgid, sh->waiterRequestPossible) == -1)
-    {
-        perror("error on the down operation for semaphore access");
-        exit(EXIT_FAILURE);
+    for (n = 0; n < nCooking; n++) {                            // the batch takes as long as its longest order
+        t = (unsigned int)floor(MAXCOOK * rngUniform(&rng) + 100.0);
+        if (t > cook) cook = t;
     }
+    passTime(sh, semgid, cook + (nCooking-1) * BATCHCOOK);
 
     //entrada na zona critica
-    if (semDown(semgid, sh->mutex) == -1)       // down no mutex (identificador para o semaforo associado ao acesso à memoria partilhada)
+    if (semOpBatch(semgid, enter, 2) == -1)     // entra nas regioes do empregado e do estado (ha sempre lugar na fila)
     {
         perror("error on the down operation for semaphore access (Chef)");
         exit(EXIT_FAILURE);
     }
 
-
-    sh->fSt.waiterRequest.reqType = FOODREADY;
-    sh->fSt.waiterRequest.reqGroup = lastGroup;
-
-
-    sh->fSt.st.chefStat = WAIT_FOR_FOOD;
+    beginUpdate(&sh->fSt);
+    CHEFSTAT(&sh->fSt)[id] = WAIT_FOR_FOOD;
     saveState(nFic, &sh->fSt);
+    endUpdate(&sh->fSt);
 
-
-    if (semUp(semgid, sh->mutex) == -1)
+    if (semUp(semgid, sh->mutex) == -1)         // exit state region
     {
         perror("error on the up operation for semaphore access (Chef)");
         exit(EXIT_FAILURE);
     }
-    
-    if (semUp(semgid, sh->waiterRequest) == -1)
+
+    for (n = 0; n < nCooking; n++)
+        READYGROUP(&sh->fSt)[sh->fSt.readyHead++] = cooking[n];
+
+    if (semOpBatch(semgid, leave, 2) == -1)     // exit waiter region and signal waiters
     {
-        perror("error on the down operation for semaphore access");
+        perror("error on the up operation for semaphore access (Chef)");
         exit(EXIT_FAILURE);
     }
+
+    flushState(nFic, &sh->fSt);
 }
+
+
@@ -30,19 +30,36 @@
 #include "logging.h"
 #include "sharedDataSync.h"
 #include "semaphore.h"
+#include "semStats.h"
 #include "sharedMemory.h"
+#include "simClock.h"
+#include "rng.h"
+
+#ifdef THREADED
+/** \brief storage class of the group variables (each group is run by its own thread) */
+#define GROUPLOCAL __thread
+#else
+/** \brief storage class of the group variables */
+#define GROUPLOCAL
+#endif
 
 /** \brief logging file name */
-static char nFic[51];
+static GROUPLOCAL char nFic[51];
 
 /** \brief shared memory block access identifier */
-static int shmid;
+static GROUPLOCAL int shmid;
 
 /** \brief semaphore set access identifier */
-static int semgid;
+static GROUPLOCAL int semgid;
 
 /** \brief pointer to shared memory region */
-static SHARED_DATA *sh;
+static GROUPLOCAL SHARED_DATA *sh;
+
+/** \brief time of arrival at the restaurant, of assignment of the table and of the end of the meal */
+static GROUPLOCAL unsigned long long arrived, seated, ate;
+
+/** \brief random generator of the group */
+static GROUPLOCAL RNG rng;
 
 static void goToRestaurant (int id);
 static void checkInAtReception (int id);
@@ -57,11 +74,16 @@ static void checkOutAtReception (int id);
  *
  *  Its role is to generate the life cycle of one of intervening entities in the problem: the group.
  */
+#ifdef THREADED
+int groupMain (int argc, char *argv[])
+#else
 int main (int argc, char *argv[])
+#endif
 {
     int key;                                         /*access key to shared memory and semaphore set */
     char *tinp;                                                    /* numerical parameters test flag */
     int n;
+    bool started = false;                                    /* the group took part in a run */
 
     /* validation of command line parameters */
     if (argc != 5) { 
@@ -75,7 +97,7 @@ int main (int argc, char *argv[])
     }
 
     n = (unsigned int) strtol (argv[1], &tinp, 0);
-    if ((*tinp != '\0') || (n >= MAXGROUPS )) { 
+    if ((*tinp != '\0') || (n < 0)) { 
         fprintf (stderr, "Group process identification is wrong!\n");
         return EXIT_FAILURE;
     }
@@ -86,12 +108,9 @@ int main (int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    /* connection to the semaphore set and the shared memory region and mapping the shared region onto the
-       process address space */
-    if ((semgid = semConnect (key)) == -1) { 
-        perror ("error on connecting to the semaphore set");
-        return EXIT_FAILURE;
-    }
+    /* connection to the shared memory region, mapping the shared region onto the process address space and
+       connection to the semaphore set; the region is pre-faulted first, since the connection to the semaphore
+       set waits for the start of operations */
     if ((shmid = shmemConnect (key)) == -1) { 
         perror ("error on connecting to the shared memory region");
         return EXIT_FAILURE;
@@ -100,18 +119,43 @@ int main (int argc, char *argv[])
         perror ("error on mapping the shared region on the process address space");
         return EXIT_FAILURE;
     }
+    if (shmemPrefault (shmid, sh, sh->memOpt) == -1) {                  /* no page faults in the life cycle */
+        perror ("error on pre-faulting the shared region");
+        return EXIT_FAILURE;
+    }
+    if ((semgid = semConnect (key)) == -1) { 
+        perror ("error on connecting to the semaphore set");
+        return EXIT_FAILURE;
+    }
+    attachLog (nFic, &sh->log);
+    if (n >= sh->fSt.nGroups) { 
+        fprintf (stderr, "Group process identification is wrong!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (statsConnect (key, POOLGROUP(n)) == -1) {
+        perror ("error on connecting to the semaphore statistics");
+        return EXIT_FAILURE;
+    }
 
-    /* initialize random generator */
-    srandom ((unsigned int) getpid ());                                                 
+    while (startRun (sh, semgid, POOLGROUP(n), &started)) {
+        /* initialize random generator (a stream of the seed of the run) */
+        rngSeed (&rng, sh->seed, ENTGROUP(n));
 
+        /* simulation of the life cycle of the group */
+        goToRestaurant(n);
+        checkInAtReception(n);
+        orderFood(n);
+        waitFood(n);
+        eat(n);
+        checkOutAtReception(n);
+    }
 
-    /* simulation of the life cycle of the group */
-    goToRestaurant(n);
-    checkInAtReception(n);
-    orderFood(n);
-    waitFood(n);
-    eat(n);
-    checkOutAtReception(n);
+    /* the entity does not take part in the simulation any more */
+    if (simDone (semgid) == -1) {
+        perror ("error on signaling the end of the entity");
+        exit (EXIT_FAILURE);
+    }
 
     /* unmapping the shared region off the process address space */
     if (shmemDettach (sh) == -1) {
@@ -131,15 +175,7 @@ int main (int argc, char *argv[])
  */
 static double normalRand(double stddev)
 {
-   int i;
-
-   double r=0.0;
-   for (i=0;i<12;i++) {
-       r += random()/(RAND_MAX+1.0);
-   }
-   r -= 6.0;
-
-   return r*stddev;
+   return rngNormal(&rng)*stddev;
 }
 
 /**
@@ -151,11 +187,12 @@ static double normalRand(double stddev)
  */
 static void goToRestaurant (int id)
 {
-    double startTime = sh->fSt.startTime[id] + normalRand(STARTDEV);
+    double startTime = STARTTIME(&sh->fSt)[id] + normalRand(STARTDEV);
     
     if (startTime > 0.0) {
-        usleep((unsigned int) startTime );
+        passTime(sh, semgid, (unsigned int) startTime );
     }
+    arrived = simNow(semgid);
 }
 
 /**
@@ -167,11 +204,12 @@ static void goToRestaurant (int id)
  */
 static void eat (int id)
 {
-    double eatTime = sh->fSt.eatTime[id] + normalRand(EATDEV);
+    double eatTime = EATTIME(&sh->fSt)[id] + normalRand(EATDEV);
     
     if (eatTime > 0.0) {
-        usleep((unsigned int) eatTime );
+        passTime(sh, semgid, (unsigned int) eatTime );
     }
+    ate = simNow(semgid);
 }
 
 /**
@@ -188,40 +226,44 @@ static void eat (int id)
  */
 static void checkInAtReception(int id)
 {
-    if (semDown(semgid, sh->receptionistRequestPossible) == -1)
-    {
-        perror("error on the down operation for semaphore access");
-        exit(EXIT_FAILURE);
-    }
-    
-    if (semDown(semgid, sh->mutex) == -1) { // enter critical region
+    SEMOP enter[] = {{ sh->receptionistRequestPossible, SEMDOWN }, { sh->receptionLock, SEMDOWN }, { sh->mutex, SEMDOWN }};
+    SEMOP leave[] = {{ sh->receptionistReq, SEMUP }, { sh->receptionLock, SEMUP }};
+
+    if (semOpBatch(semgid, enter, 3) == -1) { // wait for receptionist and enter reception and state regions
         perror("error on the down operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    sh->fSt.st.groupStat[id] = ATRECEPTION; // Change state to ATRECEPTION
+    beginUpdate(&sh->fSt);
+    GROUPSTAT(&sh->fSt)[id] = ATRECEPTION; // Change state to ATRECEPTION
     saveState(nFic, &sh->fSt);
+    endUpdate(&sh->fSt);
 
-    sh->fSt.receptionistRequest.reqType = TABLEREQ;
-    sh->fSt.receptionistRequest.reqGroup = id;
-
-    if (semUp(semgid, sh->receptionistReq) == -1) {
-        perror("error on the down operation for semaphore receptionist");
+    if (semUp(semgid, sh->mutex) == -1) { // exit state region
+        perror("error on the up operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    if (semUp(semgid, sh->mutex) == -1) { // exit critical region
+    putRequest (&sh->fSt.receptionistQueue, TABLEREQ, id);
+
+    if (semOpBatch(semgid, leave, 2) == -1) { // signal receptionist and exit reception region
         perror("error on the up operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    if (semDown(semgid, sh->waitForTable[id]) == -1) {
+    flushState(nFic, &sh->fSt);
+
+    if (semDown(semgid, sh->waitForTable + id) == -1) {
         perror("error on the down operation for semaphore receptionist");
         exit(EXIT_FAILURE);
     }
+    seated = simNow(semgid);
+    histRecord(&sh->latency[LAT_TABLE], seated - arrived);
 
 }
 
+
+
 /**
  *  \brief group orders food.
  *
@@ -235,41 +277,43 @@ static void checkInAtReception(int id)
 static void orderFood(int id)
 {
     int tableForGroup;      // Table assigned to the group
+    SEMOP enter[] = {{ sh->waiterRequestPossible, SEMDOWN }, { sh->waiterLock, SEMDOWN }, { sh->mutex, SEMDOWN }};
+    SEMOP leave[] = {{ sh->waiterRequest, SEMUP }, { sh->waiterLock, SEMUP }};
 
-    if (semDown(semgid, sh->waiterRequestPossible) == -1) {
-        perror("error on the up operation for semaphore waiter");
-        exit(EXIT_FAILURE);
-    }
-
-    if (semDown(semgid, sh->mutex) == -1) { // enter critical region
+    if (semOpBatch(semgid, enter, 3) == -1) { // wait for waiter and enter waiter and state regions
         perror("error on the down operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    sh->fSt.st.groupStat[id] = FOOD_REQUEST; // Change state to FOOD_REQUEST
+    beginUpdate(&sh->fSt);
+    GROUPSTAT(&sh->fSt)[id] = FOOD_REQUEST; // Change state to FOOD_REQUEST
     saveState(nFic, &sh->fSt);
+    endUpdate(&sh->fSt);
 
-    sh->fSt.waiterRequest.reqType = FOODREQ;        // waiter receives request
-    sh->fSt.waiterRequest.reqGroup = id;            // waiter receives the id of the group
+    tableForGroup = ASSIGNEDTABLE(&sh->fSt)[id];      // atribuir a mesa ao grupo
 
-    if (semUp(semgid, sh->waiterRequest) == -1) {
-        perror("error on the up operation for semaphore waiter");
+    if (semUp(semgid, sh->mutex) == -1) { // exit state region
+        perror("error on the up operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    tableForGroup = sh->fSt.assignedTable[id];      // atribuir a mesa ao grupo
+    putRequest (&sh->fSt.waiterQueue, FOODREQ, id);     // waiter receives request and the id of the group
 
-    if (semUp(semgid, sh->mutex) == -1) { // exit critical region
+    if (semOpBatch(semgid, leave, 2) == -1) { // signal waiter and exit waiter region
         perror("error on the up operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    if (semDown(semgid, sh->requestReceived[tableForGroup]) == -1) {
+    flushState(nFic, &sh->fSt);
+
+    if (semDown(semgid, sh->requestReceived + tableForGroup) == -1) {
         perror("error on the up operation for semaphore waiter");
         exit(EXIT_FAILURE);
     }
 }
 
+
+
 /**
  *  \brief group waits for food.
  *
@@ -288,38 +332,43 @@ static void waitFood(int id)
         exit(EXIT_FAILURE);
     }
 
-    sh->fSt.st.groupStat[id] = WAIT_FOR_FOOD; // Change state to WAIT_FOR_FOOD
+    beginUpdate(&sh->fSt);
+    GROUPSTAT(&sh->fSt)[id] = WAIT_FOR_FOOD; // Change state to WAIT_FOR_FOOD
     saveState(nFic, &sh->fSt);
+    endUpdate(&sh->fSt);
 
-    tableForGroup = sh->fSt.assignedTable[id];      // atribuir a mesa ao grupo
+    tableForGroup = ASSIGNEDTABLE(&sh->fSt)[id];      // atribuir a mesa ao grupo
 
     if (semUp(semgid, sh->mutex) == -1) { // exit critical region
         perror("error on the up operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    int sem_foodArriv = sh->foodArrived[tableForGroup];
+    flushState(nFic, &sh->fSt);
 
-    if (semDown(semgid, sem_foodArriv) == -1) {
-        perror("error on the down operation for semaphore access");
-        exit(EXIT_FAILURE);
-    }
+    SEMOP enter[] = {{ sh->foodArrived + tableForGroup, SEMDOWN }, { sh->mutex, SEMDOWN }};
 
-    if (semDown(semgid, sh->mutex) == -1) { // enter critical region
+    if (semOpBatch(semgid, enter, 2) == -1) { // wait for food and enter critical region
         perror("error on the down operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    sh->fSt.st.groupStat[id] = EAT; // Change state to EAT
+    beginUpdate(&sh->fSt);
+    GROUPSTAT(&sh->fSt)[id] = EAT; // Change state to EAT
     saveState(nFic, &sh->fSt);
+    endUpdate(&sh->fSt);
+    histRecord(&sh->latency[LAT_FOOD], simNow(semgid) - seated);
 
 
     if (semUp(semgid, sh->mutex) == -1) { // exit critical region
         perror("error on the up operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
+
+    flushState(nFic, &sh->fSt);
 }
 
+
 /**
  *  \brief group check out at reception. 
  *
@@ -334,59 +383,54 @@ static void waitFood(int id)
 static void checkOutAtReception(int id)
 {
     int tableForGroup;
+    SEMOP enter[] = {{ sh->receptionistRequestPossible, SEMDOWN }, { sh->receptionLock, SEMDOWN }, { sh->mutex, SEMDOWN }};
+    SEMOP leave[] = {{ sh->receptionistReq, SEMUP }, { sh->receptionLock, SEMUP }};
 
-    if (semDown(semgid, sh->receptionistRequestPossible) == -1) {
-        perror("error on the down operation for semaphore access");
-        exit(EXIT_FAILURE);
-    }
-
-    if (semDown(semgid, sh->mutex) == -1) { // enter critical region
+    if (semOpBatch(semgid, enter, 3) == -1) { // wait for receptionist and enter reception and state regions
         perror("error on the down operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    sh->fSt.st.groupStat[id] = CHECKOUT; // Change state to CHECKOUT
+    beginUpdate(&sh->fSt);
+    GROUPSTAT(&sh->fSt)[id] = CHECKOUT; // Change state to CHECKOUT
     saveState(nFic, &sh->fSt);
+    endUpdate(&sh->fSt);
 
-    sh->fSt.receptionistRequest.reqType = BILLREQ;      // receptionist receives the bill request
-    sh->fSt.receptionistRequest.reqGroup = id;          // and receptionist receives the id of the group
+    tableForGroup = ASSIGNEDTABLE(&sh->fSt)[id];      // retirar o id da mesa que vai ficar livre, pois o grupo vai sair
 
-    if (semUp(semgid, sh->receptionistReq) == -1) {
-        perror("error on the down operation for semaphore access");
+    if (semUp(semgid, sh->mutex) == -1) { // exit state region
+        perror("error on the up operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    tableForGroup = sh->fSt.assignedTable[id];      // retirar o id da mesa que vai ficar livre, pois o grupo vai sair
+    putRequest (&sh->fSt.receptionistQueue, BILLREQ, id);   // receptionist receives the bill request and the id of the group
 
-    if (semUp(semgid, sh->mutex) == -1) { // exit critical region
+    if (semOpBatch(semgid, leave, 2) == -1) { // signal receptionist and exit reception region
         perror("error on the up operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    int sem_reqReceived = sh->requestReceived[tableForGroup];
+    flushState(nFic, &sh->fSt);
 
-    if (semDown(semgid, sem_reqReceived) == -1) {
-        perror("error on the down operation for semaphore receptionist");
-        exit(EXIT_FAILURE);
-    }
+    SEMOP done[] = {{ sh->tableDone + tableForGroup, SEMDOWN }, { sh->mutex, SEMDOWN }};
 
-    int sem_tableDone = sh->tableDone[tableForGroup];
-
-    if (semDown(semgid, sem_tableDone) == -1) {
-        perror("error on the down operation for semaphore receptionist");
-        exit(EXIT_FAILURE);
-    }
-
-    if (semDown(semgid, sh->mutex) == -1) { // enter critical region
+    if (semOpBatch(semgid, done, 2) == -1) { // wait for payment and enter state region
         perror("error on the down operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
 
-    sh->fSt.st.groupStat[id] = LEAVING; // Change state to LEAVING
+    beginUpdate(&sh->fSt);
+    GROUPSTAT(&sh->fSt)[id] = LEAVING; // Change state to LEAVING
     saveState(nFic, &sh->fSt);
+    endUpdate(&sh->fSt);
+    histRecord(&sh->latency[LAT_CHECKOUT], simNow(semgid) - ate);
 
-    if (semUp(semgid, sh->mutex) == -1) { // exit critical region
+    if (semUp(semgid, sh->mutex) == -1) { // exit state region
         perror("error on the up operation for semaphore access (CT)");
         exit(EXIT_FAILURE);
     }
+
+    flushState(nFic, &sh->fSt);
 }
+
+
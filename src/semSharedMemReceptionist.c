@@ -28,7 +28,9 @@
 #include "logging.h"
 #include "sharedDataSync.h"
 #include "semaphore.h"
+#include "semStats.h"
 #include "sharedMemory.h"
+#include "simClock.h"
 
 /** \brief logging file name */
 static char nFic[51];
@@ -49,7 +51,37 @@ static SHARED_DATA *sh;
 #define DONE     3
 
 /** \brief receptioninst view on each group evolution (useful to decide table binding) */
-static int groupRecord[MAXGROUPS];
+static int *groupRecord;
+
+/** \brief number of bits in a word of the free-table bitmap */
+#define WORDBITS ((int) (8 * sizeof (unsigned long)))
+
+/** \brief free-table bitmap; bit i stands for table nTables-1-i, so the lowest set bit is the highest vacant table */
+static unsigned long *freeTables;
+
+/** \brief number of words in the free-table bitmap and lowest word that may have a set bit */
+static int nWords, firstWord = 0;
+
+/** \brief binary heap of the groups waiting for table, ordered by <tt>waitKey</tt> (nGroups entries) */
+static int *waitingGroups;
+
+/** \brief key of each waiting group under the table scheduling policy (the smallest one leaves the heap first) */
+static unsigned long long *waitKey;
+
+/** \brief number of groups in the heap and of table requests received so far */
+static unsigned int nWaiting = 0, nArrived = 0;
+
+/** \brief time of the table request and of the assignment of the table of each group */
+static unsigned long long *requestedAt, *seatedAt;
+
+/** \brief use of the tables, copied to the shared region at the end */
+static TABLE_REPORT report;
+
+/** \brief requests taken from the queue and not yet served */
+static request pending[REQQUEUESIZE];
+
+/** \brief number of requests in <tt>pending</tt> and position of the next one to be served */
+static unsigned int nPending = 0, nextPending = 0;
 
 
 /** \brief receptionist waits for next request */
@@ -68,10 +100,15 @@ static void receivePayment (int n);
  *
  *  Its role is to generate the life cycle of one of intervening entities in the problem: the receptionist.
  */
+#ifdef THREADED
+int receptionistMain (int argc, char *argv[])
+#else
 int main (int argc, char *argv[])
+#endif
 {
     int key;                                            /*access key to shared memory and semaphore set */
     char *tinp;                                                       /* numerical parameters test flag */
+    bool started = false;                                        /* the receptionist took part in a run */
 
     /* validation of command line parameters */
     if (argc != 4) { 
@@ -80,7 +117,9 @@ int main (int argc, char *argv[])
         return EXIT_FAILURE;
     }
     else { 
+#ifndef THREADED
         freopen (argv[3], "w", stderr);
+#endif
         setbuf(stderr,NULL);
     }
 
@@ -91,12 +130,9 @@ int main (int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    /* connection to the semaphore set and the shared memory region and mapping the shared region onto the
-       process address space */
-    if ((semgid = semConnect (key)) == -1) { 
-        perror ("error on connecting to the semaphore set");
-        return EXIT_FAILURE;
-    }
+    /* connection to the shared memory region, mapping the shared region onto the process address space and
+       connection to the semaphore set; the region is pre-faulted first, since the connection to the semaphore
+       set waits for the start of operations */
     if ((shmid = shmemConnect (key)) == -1) { 
         perror ("error on connecting to the shared memory region");
         return EXIT_FAILURE;
@@ -105,30 +141,78 @@ int main (int argc, char *argv[])
         perror ("error on mapping the shared region on the process address space");
         return EXIT_FAILURE;
     }
-
-    /* initialize random generator */
-    srandom ((unsigned int) getpid ());              
-
-    /* initialize internal receptionist memory */
-    int g;
-    for (g=0; g < sh->fSt.nGroups; g++) {
-       groupRecord[g] = TOARRIVE;
+    if (shmemPrefault (shmid, sh, sh->memOpt) == -1) {                  /* no page faults in the life cycle */
+        perror ("error on pre-faulting the shared region");
+        return EXIT_FAILURE;
+    }
+    if ((semgid = semConnect (key)) == -1) { 
+        perror ("error on connecting to the semaphore set");
+        return EXIT_FAILURE;
+    }
+    attachLog (nFic, &sh->log);
+    if (statsConnect (key, POOLRECEPTIONIST) == -1) {
+        perror ("error on connecting to the semaphore statistics");
+        return EXIT_FAILURE;
     }
 
-    /* simulation of the life cycle of the receptionist */
-    int nReq=0;
+    int g;
+    int nReq;
     request req;
-    while( nReq < sh->fSt.nGroups*2 ) {
-        req = waitForGroup();
-        switch(req.reqType) {
-            case TABLEREQ:
-                   provideTableOrWaitingRoom(req.reqGroup); //TODO param should be groupid
-                   break;
-            case BILLREQ:
-                   receivePayment(req.reqGroup);
-                   break;
+    while (startRun (sh, semgid, POOLRECEPTIONIST, &started)) {
+        /* initialize internal receptionist memory (the sizes may change from run to run) */
+        if ((groupRecord = malloc (sh->fSt.nGroups * sizeof (int))) == NULL) {
+            perror ("error on allocating the receptionist view on groups");
+            return EXIT_FAILURE;
+        }
+        for (g=0; g < sh->fSt.nGroups; g++) {
+           groupRecord[g] = TOARRIVE;
+        }
+        nWords = (sh->fSt.nTables + WORDBITS - 1) / WORDBITS;
+        if (((freeTables = calloc (nWords, sizeof (unsigned long))) == NULL) ||
+            ((waitingGroups = malloc (sh->fSt.nGroups * sizeof (int))) == NULL) ||
+            ((waitKey = malloc (sh->fSt.nGroups * sizeof (unsigned long long))) == NULL) ||
+            ((requestedAt = malloc (sh->fSt.nGroups * sizeof (unsigned long long))) == NULL) ||
+            ((seatedAt = malloc (sh->fSt.nGroups * sizeof (unsigned long long))) == NULL)) {
+            perror ("error on allocating the receptionist view on tables");
+            return EXIT_FAILURE;
+        }
+        for (g=0; g < sh->fSt.nTables; g++) {
+           freeTables[g / WORDBITS] |= 1UL << (g % WORDBITS);
+        }
+        firstWord = 0;
+        nWaiting = nArrived = 0;
+        nPending = nextPending = 0;
+        memset (&report, 0, sizeof (report));
+
+        /* simulation of the life cycle of the receptionist */
+        nReq=0;
+        while( nReq < sh->fSt.nGroups*2 ) {
+            req = waitForGroup();
+            switch(req.reqType) {
+                case TABLEREQ:
+                       provideTableOrWaitingRoom(req.reqGroup); //TODO param should be groupid
+                       break;
+                case BILLREQ:
+                       receivePayment(req.reqGroup);
+                       break;
+            }
+            nReq++;
         }
-        nReq++;
+
+        sh->tables = report;                           /* read by the main program when all have ended the run */
+
+        free (groupRecord);
+        free (freeTables);
+        free (waitingGroups);
+        free (waitKey);
+        free (requestedAt);
+        free (seatedAt);
+    }
+
+    /* the entity does not take part in the simulation any more */
+    if (simDone (semgid) == -1) {
+        perror ("error on signaling the end of the entity");
+        exit (EXIT_FAILURE);
     }
 
     /* unmapping the shared region off the process address space */
@@ -140,27 +224,101 @@ int main (int argc, char *argv[])
     return EXIT_SUCCESS;
 }
 
+/**
+ *  \brief takes the highest numbered vacant table off the free-table bitmap.
+ *
+ *  \return table id or -1 (if all tables are occupied)
+ */
+static int takeTable()
+{
+    for (; firstWord < nWords; firstWord++) {
+        if (freeTables[firstWord] != 0) {
+            int bit = firstWord * WORDBITS + __builtin_ctzl (freeTables[firstWord]);
+
+            freeTables[firstWord] &= freeTables[firstWord] - 1;                           /* clear lowest set bit */
+            return sh->fSt.nTables - 1 - bit;
+        }
+    }
+    return -1;
+}
+
+/**
+ *  \brief puts table t back in the free-table bitmap.
+ */
+static void releaseTable(int t)
+{
+    int bit = sh->fSt.nTables - 1 - t;
+
+    freeTables[bit / WORDBITS] |= 1UL << (bit % WORDBITS);
+    if (bit / WORDBITS < firstWord) {
+        firstWord = bit / WORDBITS;
+    }
+}
+
+/**
+ *  \brief puts group n in the heap of waiting groups.
+ *
+ *  Its key is its arrival order (POLICY_FIFO), its expected eat time followed by its arrival order
+ *  (POLICY_SEF) or its id (POLICY_INDEX).
+ */
+static void pushWaiting(int n)
+{
+    unsigned long long key;
+    unsigned int k = nWaiting++, up;
+
+    switch (sh->fSt.tablePolicy) {
+        case POLICY_SEF:   key = ((unsigned long long) EATTIME(&sh->fSt)[n] << 32) | nArrived; break;
+        case POLICY_INDEX: key = (unsigned long long) n; break;
+        default:           key = nArrived;
+    }
+    waitKey[n] = key;
+    for (; k > 0; k = up) {                                               /* sift up */
+        up = (k - 1) / 2;
+        if (waitKey[waitingGroups[up]] <= key)
+            break;
+        waitingGroups[k] = waitingGroups[up];
+    }
+    waitingGroups[k] = n;
+}
+
+/**
+ *  \brief takes the group with the smallest key off the heap of waiting groups.
+ *
+ *  \return group id or -1 (if no group is waiting)
+ */
+static int popWaiting()
+{
+    int first, last;
+    unsigned int k = 0, c;
+
+    if (nWaiting == 0)
+        return -1;
+    first = waitingGroups[0];
+    last = waitingGroups[--nWaiting];
+    while ((c = 2 * k + 1) < nWaiting) {                                  /* sift down */
+        if ((c + 1 < nWaiting) && (waitKey[waitingGroups[c+1]] < waitKey[waitingGroups[c]]))
+            c += 1;
+        if (waitKey[last] <= waitKey[waitingGroups[c]])
+            break;
+        waitingGroups[k] = waitingGroups[c];
+        k = c;
+    }
+    waitingGroups[k] = last;
+    return first;
+}
+
 /**
  *  \brief decides table to occupy for group n or if it must wait.
  *
- *  Checks current state of tables and groups in order to decide table or wait.
+ *  Takes the highest numbered vacant table, if any, off the free-table bitmap.
  *
  *  \return table id or -1 (in case of wait decision)
  */
 static int decideTableOrWait(int n)
 {
     //TODO insert your code here
-    if(sh->fSt.st.groupStat[n] == ATRECEPTION && sh->fSt.assignedTable[n] == -1){
-        int occupied = 0;
-        for(int num = 0; num < sh->fSt.nGroups; num++)
-            if(sh->fSt.assignedTable[num] != -1)
-                occupied += 1 + sh->fSt.assignedTable[num];
-
-        if(occupied <= 1)
-            return 1;
-        if(occupied == 2)
-            return 0;
-    }
+    if(GROUPSTAT(&sh->fSt)[n] == ATRECEPTION && ASSIGNEDTABLE(&sh->fSt)[n] == -1)
+        return takeTable();
 
     return -1;
 }
@@ -169,32 +327,31 @@ static int decideTableOrWait(int n)
  *  \brief called when a table gets vacant and there are waiting groups 
  *         to decide which group (if any) should occupy it.
  *
- *  Checks current state of tables and groups in order to decide group.
+ *  The waiting group chosen by the table scheduling policy of the run leaves the heap of waiting groups.
  *
  *  \return group id or -1 (in case of wait decision)
  */
 static int decideNextGroup()
 {
      //TODO insert your code here
-     for(int num = 0; num < sh->fSt.nGroups; num++)
-        if(decideTableOrWait(num) != -1 && groupRecord[num] == WAIT)
-            return num;
-
-     return -1;
+     return popWaiting();
 }
 
 /**
  *  \brief receptionist waits for next request 
  *
- *  Receptionist updates state and waits for request from group, then reads request,
- *  and signals availability for new request.
+ *  Receptionist updates state and waits for request from group, then takes all the queued requests,
+ *  and signals availability of as many slots for new requests.
+ *  Requests already taken are served first, in arrival order, without waiting.
  *  The internal state should be saved.
  *
  *  \return request submitted by group
  */
 static request waitForGroup()
 {
-    request ret; 
+    SEMOP enter[] = {{ sh->receptionistReq, SEMDOWN }, { sh->receptionLock, SEMDOWN }};
+    SEMOP leave[3];
+    unsigned int nops = 0;
 
     if (semDown (semgid, sh->mutex) == -1)  {        /* enter critical region */
         perror ("error on the up operation for semaphore access (WT)");
@@ -202,43 +359,46 @@ static request waitForGroup()
     }
 
     // TODO insert your code here
+    beginUpdate(&sh->fSt);
     sh->fSt.st.receptionistStat = WAIT_FOR_REQUEST;
     saveState(nFic, &sh->fSt);
+    endUpdate(&sh->fSt);
     
     if (semUp (semgid, sh->mutex) == -1){
         perror ("error on the down operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
 
-    if (semDown (semgid, sh->receptionistReq) == -1)  {
-        perror ("error on the up operation for semaphore access");
-        exit (EXIT_FAILURE);
-    }
+    flushState(nFic, &sh->fSt);
 
-    if (semDown (semgid, sh->mutex) == -1)  {       /* enter critical region */
+    if (nextPending < nPending)
+        return pending[nextPending++];
+
+    if (semOpBatch (semgid, enter, 2) == -1)  {       /* wait for request and enter reception region */
         perror ("error on the up operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
 
     // TODO insert your code here
     
-    ret = sh->fSt.receptionistRequest;
-
-    if (semUp (semgid, sh->mutex) == -1) {
+    nPending = takeRequests (&sh->fSt.receptionistQueue, pending, REQQUEUESIZE);
+    nextPending = 0;
+
+    if (nPending > 1)                      /* the remaining requests were already signalled by their producers */
+        leave[nops++] = (SEMOP) { sh->receptionistReq, -(int) (nPending-1) };
+    leave[nops++] = (SEMOP) { sh->receptionLock, SEMUP };
+    leave[nops++] = (SEMOP) { sh->receptionistRequestPossible, (int) nPending };
+    if (semOpBatch (semgid, leave, nops) == -1) {       /* exit reception region and allow new requests */
         perror ("error on the down operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
 
-    if (semUp (semgid, sh->receptionistRequestPossible) == -1){
-        perror ("error on the down operation for semaphore access");
-        exit (EXIT_FAILURE);
-    }
-
     // TODO insert your code here
 
-    return ret;
+    return pending[nextPending++];
 }
 
+
 /**
  *  \brief receptionist decides if group should occupy table or wait
  *
@@ -250,39 +410,51 @@ static request waitForGroup()
  */
 static void provideTableOrWaitingRoom (int n)
 {
+    SEMOP leave[] = {{ sh->mutex, SEMUP }, { sh->waitForTable + n, SEMUP }};
+    unsigned long long now = simNow (semgid);
+
+    if (nArrived == 0)
+        report.first = now;
+    requestedAt[n] = now;
+
     if (semDown (semgid, sh->mutex) == -1)  {         /* enter critical region */
         perror ("error on the up operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
 
     // TODO insert your code here
+    beginUpdate(&sh->fSt);
     sh->fSt.st.receptionistStat = ASSIGNTABLE;
     saveState(nFic, &sh->fSt);
 
     int choiceTable = decideTableOrWait(n);
 
     if(choiceTable != -1){
-        if (semUp (semgid, sh->waitForTable[n]) == -1) {
-            perror ("error on the down operation for semaphore access (WT)");
-            exit (EXIT_FAILURE);
-        }
-
         groupRecord[n] = ATTABLE;
 
-        sh->fSt.assignedTable[n] = choiceTable;
+        ASSIGNEDTABLE(&sh->fSt)[n] = choiceTable;
+        seatedAt[n] = now;
+        report.seated++;
 
     } else{
 
         groupRecord[n] = WAIT;
+        pushWaiting(n);
         sh->fSt.groupsWaiting++;
     }
+    nArrived++;
+    endUpdate(&sh->fSt);
 
-    if (semUp (semgid, sh->mutex) == -1) {           /* exit critical region */
+    /* exit critical region and, if a table was assigned, let the group proceed */
+    if (semOpBatch (semgid, leave, (choiceTable != -1) ? 2 : 1) == -1) {
         perror ("error on the down operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
+
+    flushState(nFic, &sh->fSt);
 }
 
+
 /**
  *  \brief receptionist receives payment 
  *
@@ -295,25 +467,31 @@ static void provideTableOrWaitingRoom (int n)
 
 static void receivePayment (int n)
 {
+    SEMOP leave[3];
+    unsigned int nOps = 0;
+    unsigned long long now = simNow (semgid);
+
+    report.busySum += now - seatedAt[n];
+    report.last = now;
+
     if (semDown (semgid, sh->mutex) == -1)  {                                                  /* enter critical region */
         perror ("error on the up operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
 
     // TODO insert your code here
-    int emptyTable = sh->fSt.assignedTable[n];
-    int newTableForGroup;
+    int emptyTable = ASSIGNEDTABLE(&sh->fSt)[n];
+    int newTableForGroup = -1;
 
+    beginUpdate(&sh->fSt);
     sh->fSt.st.receptionistStat = RECVPAY;
     saveState(nFic, &sh->fSt);
 
-    if (semUp (semgid, sh->tableDone[emptyTable]) == -1)  {
-        perror ("error on the down operation for semaphore access");
-        exit (EXIT_FAILURE);
-    }
+    leave[nOps].sindex = sh->tableDone + emptyTable;
+    leave[nOps++].op = SEMUP;
 
     groupRecord[n] = DONE;
-    sh->fSt.assignedTable[n] = -1;
+    ASSIGNEDTABLE(&sh->fSt)[n] = -1;
 
     if(sh->fSt.groupsWaiting > 0){
         sh->fSt.st.receptionistStat = ASSIGNTABLE;
@@ -322,22 +500,32 @@ static void receivePayment (int n)
         newTableForGroup = decideNextGroup();
 
         if(newTableForGroup != -1){
-            sh->fSt.assignedTable[newTableForGroup] = emptyTable;
+            ASSIGNEDTABLE(&sh->fSt)[newTableForGroup] = emptyTable;
             groupRecord[newTableForGroup] = ATTABLE;
+            seatedAt[newTableForGroup] = now;
+            report.waitSum += now - requestedAt[newTableForGroup];
+            report.seated++;
 
-            if (semUp (semgid, sh->waitForTable[newTableForGroup]) == -1)  {
-                perror ("error on the down operation for semaphore access");
-                exit (EXIT_FAILURE);
-            }
+            leave[nOps].sindex = sh->waitForTable + newTableForGroup;
+            leave[nOps++].op = SEMUP;
 
             sh->fSt.groupsWaiting--;
         }
     }
+    if(newTableForGroup == -1)
+        releaseTable(emptyTable);
+    endUpdate(&sh->fSt);
+
+    leave[nOps].sindex = sh->mutex;
+    leave[nOps++].op = SEMUP;
 
-    if (semUp (semgid, sh->mutex) == -1)  {                                                  /* exit critical region */
+    /* release the paying group (and the one taking its table) and exit critical region */
+    if (semOpBatch (semgid, leave, nOps) == -1)  {
         perror ("error on the down operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
 
+    flushState(nFic, &sh->fSt);
+
     // TODO insert your code here
-}
\ No newline at end of file
+}
@@ -28,28 +28,54 @@
 #include "logging.h"
 #include "sharedDataSync.h"
 #include "semaphore.h"
+#include "semStats.h"
 #include "sharedMemory.h"
+#include "simClock.h"
+
+#ifdef THREADED
+/** \brief storage class of the waiter variables (each waiter is run by its own thread) */
+#define WAITERLOCAL __thread
+#else
+/** \brief storage class of the waiter variables */
+#define WAITERLOCAL
+#endif
+
+/** \brief largest number of dishes taken to their tables in one pass (one batch wakes up all the groups) */
+#define FOODBATCH (SEMBATCHMAX-1)
+
+/** \brief largest number of requests taken at once by the only waiter: a batch of dishes ready and all the requests
+           queued by the groups */
+#define TAKEMAX (FOODBATCH+REQQUEUESIZE)
 
 /** \brief logging file name */
-static char nFic[51];
+static WAITERLOCAL char nFic[51];
 
 /** \brief shared memory block access identifier */
-static int shmid;
+static WAITERLOCAL int shmid;
 
 /** \brief semaphore set access identifier */
-static int semgid;
+static WAITERLOCAL int semgid;
 
 /** \brief pointer to shared memory region */
-static SHARED_DATA *sh;
+static WAITERLOCAL SHARED_DATA *sh;
+
+/** \brief requests taken from the queues and not yet served */
+static WAITERLOCAL request pending[TAKEMAX];
+
+/** \brief number of requests in <tt>pending</tt> and position of the next one to be served */
+static WAITERLOCAL unsigned int nPending = 0, nextPending = 0;
+
+/** \brief the last request was taken by this waiter */
+static WAITERLOCAL bool lastTaken = false;
 
 /** \brief waiter waits for next request */
-static request waitForClientOrChef ();
+static request waitForClientOrChef (int id);
 
 /** \brief waiter takes food order to chef */
-static void informChef(int group);
+static void informChef(int id, int group);
 
 /** \brief waiter takes food to table */
-static void takeFoodToTable (int group);
+static void takeFoodToTable (int id, int group);
 
 
 
@@ -59,35 +85,45 @@ static void takeFoodToTable (int group);
  *
  *  Its role is to generate the life cycle of one of intervening entities in the problem: the waiter.
  */
+#ifdef THREADED
+int waiterMain (int argc, char *argv[])
+#else
 int main (int argc, char *argv[])
+#endif
 {
     int key;                                            /*access key to shared memory and semaphore set */
     char *tinp;                                                       /* numerical parameters test flag */
+    int n;
+    bool started = false;                                   /* the waiter took part in a run */
 
     /* validation of command line parameters */
-    if (argc != 4) { 
+    if (argc != 5) { 
         freopen ("error_WT", "a", stderr);
         fprintf (stderr, "Number of parameters is incorrect!\n");
         return EXIT_FAILURE;
     }
     else { 
-        freopen (argv[3], "w", stderr);
+#ifndef THREADED
+        freopen (argv[4], "w", stderr);
+#endif
         setbuf(stderr,NULL);
     }
 
-    strcpy (nFic, argv[1]);
-    key = (unsigned int) strtol (argv[2], &tinp, 0);
+    n = (unsigned int) strtol (argv[1], &tinp, 0);
+    if ((*tinp != '\0') || (n < 0)) { 
+        fprintf (stderr, "Waiter process identification is wrong!\n");
+        return EXIT_FAILURE;
+    }
+    strcpy (nFic, argv[2]);
+    key = (unsigned int) strtol (argv[3], &tinp, 0);
     if (*tinp != '\0') {
         fprintf (stderr, "Error on the access key communication!\n");
         return EXIT_FAILURE;
     }
 
-    /* connection to the semaphore set and the shared memory region and mapping the shared region onto the
-       process address space */
-    if ((semgid = semConnect (key)) == -1) { 
-        perror ("error on connecting to the semaphore set");
-        return EXIT_FAILURE;
-    }
+    /* connection to the shared memory region, mapping the shared region onto the process address space and
+       connection to the semaphore set; the region is pre-faulted first, since the connection to the semaphore
+       set waits for the start of operations */
     if ((shmid = shmemConnect (key)) == -1) { 
         perror ("error on connecting to the shared memory region");
         return EXIT_FAILURE;
@@ -96,24 +132,45 @@ int main (int argc, char *argv[])
         perror ("error on mapping the shared region on the process address space");
         return EXIT_FAILURE;
     }
+    if (shmemPrefault (shmid, sh, sh->memOpt) == -1) {                  /* no page faults in the life cycle */
+        perror ("error on pre-faulting the shared region");
+        return EXIT_FAILURE;
+    }
+    if ((semgid = semConnect (key)) == -1) { 
+        perror ("error on connecting to the semaphore set");
+        return EXIT_FAILURE;
+    }
+    attachLog (nFic, &sh->log);
+    if (n >= sh->fSt.nWaiters) { 
+        fprintf (stderr, "Waiter process identification is wrong!\n");
+        return EXIT_FAILURE;
+    }
+    if (statsConnect (key, POOLWAITER(n)) == -1) {
+        perror ("error on connecting to the semaphore statistics");
+        return EXIT_FAILURE;
+    }
 
-    /* initialize random generator */
-    srandom ((unsigned int) getpid ());              
-
-    /* simulation of the life cycle of the waiter */
-    int nReq=0;
+    /* simulation of the life cycle of the waiter: the waiters share the requests, until all of them are taken */
     request req;
-    while( nReq < sh->fSt.nGroups*2 ) {
-        req = waitForClientOrChef();
-        switch(req.reqType) {
-            case FOODREQ:
-                   informChef(req.reqGroup);
-                   break;
-            case FOODREADY:
-                   takeFoodToTable(req.reqGroup);
-                   break;
+    while (startRun (sh, semgid, POOLWAITER(n), &started)) {
+        nPending = nextPending = 0;
+        lastTaken = false;
+        while( (req = waitForClientOrChef(n)).reqType != NOREQ ) {
+            switch(req.reqType) {
+                case FOODREQ:
+                       informChef(n, req.reqGroup);
+                       break;
+                case FOODREADY:
+                       takeFoodToTable(n, req.reqGroup);
+                       break;
+            }
         }
-        nReq++;
+    }
+
+    /* the entity does not take part in the simulation any more */
+    if (simDone (semgid) == -1) {
+        perror ("error on signaling the end of the entity");
+        exit (EXIT_FAILURE);
     }
 
     /* unmapping the shared region off the process address space */
@@ -128,67 +185,114 @@ int main (int argc, char *argv[])
 /**
  *  \brief waiter waits for next request 
  *
- *  Waiter updates state and waits for request from group or from chef, then reads request.
- *  The waiter should signal that new requests are possible.
+ *  Waiter updates state and waits for request from group or from chef, then takes the dishes ready
+ *  followed by the queued requests of groups: all of them (up to TAKEMAX) if it is the only waiter,
+ *  otherwise the dishes ready (up to FOODBATCH, as they are delivered together) or, if there are none, one
+ *  request, so the requests are spread among the waiters.
+ *  The waiter should signal that as many new requests from groups are possible.
+ *  Requests already taken are served first, in arrival order, without waiting.
+ *  The waiter that takes the last request finishes after serving it and wakes up the other waiters, which
+ *  find no request and finish; a waiter that finds no request while others are still to come waits again.
  *  The internal state should be saved.
  *
- *  \return request submitted by group or chef
+ *  \param id waiter id
+ *
+ *  \return request submitted by group or chef, or NOREQ if all the requests were taken
  */
-static request waitForClientOrChef()
+static request waitForClientOrChef(int id)
 {
-    request req; 
+    SEMOP enter[] = {{ sh->waiterRequest, SEMDOWN }, { sh->waiterLock, SEMDOWN }};
+    SEMOP leave[4];
+    unsigned int nops = 0;
+    unsigned int max = (sh->fSt.nWaiters == 1) ? TAKEMAX : FOODBATCH;
+    unsigned int nFood;                                    /* number of requests issued by groups */
 
     if (semDown(semgid, sh->mutex) == -1) {                                                  /* enter critical region */
         perror("error on the down operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
 
-    sh->fSt.st.waiterStat = WAIT_FOR_REQUEST;
+    beginUpdate(&sh->fSt);
+    WAITERSTAT(&sh->fSt)[id] = WAIT_FOR_REQUEST;
     saveState(nFic, &sh->fSt); 
+    endUpdate(&sh->fSt);
 
     if (semUp(semgid, sh->mutex) == -1) {                                                   /* exit critical region */
         perror("error on the up operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
 
-    if (semDown(semgid, sh->waiterRequest) == -1) {
-        perror("error on the down operation for semaphore access (WT)");
-        exit(EXIT_FAILURE);
-    }
+    flushState(nFic, &sh->fSt);
 
-    if (semDown(semgid, sh->mutex) == -1) {
-        perror("error on the down operation for semaphore access (WT)");
-        exit(EXIT_FAILURE);
-    }
+    if (nextPending < nPending)
+        return pending[nextPending++];
+    if (lastTaken)
+        return (request) { NOREQ, 0 };
 
-    req.reqGroup = sh->fSt.waiterRequest.reqGroup;
-    req.reqType = sh->fSt.waiterRequest.reqType;
+    while (true) {
+        if (semOpBatch(semgid, enter, 2) == -1) {                     /* wait for request and enter waiter region */
+            perror("error on the down operation for semaphore access (WT)");
+            exit(EXIT_FAILURE);
+        }
 
-    if (semUp(semgid, sh->mutex) == -1) {                                                   /* exit critical region */
-        perror("error on the up operation for semaphore access (WT)");
-        exit(EXIT_FAILURE);
+        nPending = 0;
+        while ((nPending < max) && (sh->fSt.readyTail != sh->fSt.readyHead))
+            pending[nPending++] = (request) { FOODREADY, READYGROUP(&sh->fSt)[sh->fSt.readyTail++] };
+        if (sh->fSt.nWaiters > 1)                     /* several waiters: the dishes or a single request */
+            max = (nPending == 0) ? 1 : nPending;
+        nFood = takeRequests(&sh->fSt.waiterQueue, pending + nPending, max - nPending);
+        nPending += nFood;
+        nextPending = 0;
+        if (nPending > 0)
+            break;
+
+        lastTaken = (sh->fSt.readyTail == (unsigned int) sh->fSt.nGroups) &&
+                    (sh->fSt.waiterQueue.tail == (unsigned int) sh->fSt.nGroups);
+        if (semUp(semgid, sh->waiterLock) == -1) {                                        /* exit waiter region */
+            perror("error on the up operation for semaphore access (WT)");
+            exit(EXIT_FAILURE);
+        }
+        if (lastTaken)                                   /* woken up by the waiter that took the last request */
+            return (request) { NOREQ, 0 };
+        /* woken up by a dish already taken by another waiter along with the one it was woken up by: wait again */
     }
 
-    if (semUp(semgid, sh->waiterRequestPossible) == -1) {
+    /* with a single waiter, the remaining requests were already signalled by their producers; with several,
+       the signals of the dishes are left to the other waiters, which may already be waiting for the waiter
+       region after taking them (the batches of the futex and virtual-time backends are not atomic) */
+    if ((nPending > 1) && (sh->fSt.nWaiters == 1))
+        leave[nops++] = (SEMOP) { sh->waiterRequest, -(int) (nPending-1) };
+    lastTaken = (sh->fSt.readyTail == (unsigned int) sh->fSt.nGroups) &&
+                (sh->fSt.waiterQueue.tail == (unsigned int) sh->fSt.nGroups);
+    if (lastTaken && (sh->fSt.nWaiters > 1))                      /* the other waiters are woken up to finish */
+        leave[nops++] = (SEMOP) { sh->waiterRequest, sh->fSt.nWaiters-1 };
+    leave[nops++] = (SEMOP) { sh->waiterLock, SEMUP };
+    if (nFood > 0)                          /* notifications of the chef do not take slots of groups */
+        leave[nops++] = (SEMOP) { sh->waiterRequestPossible, (int) nFood };
+    if (semOpBatch(semgid, leave, nops) == -1) {                   /* exit waiter region and allow new requests */
         perror("error on the up operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
 
-    return req;
+    return pending[nextPending++];
 }
 
+
 /**
  *  \brief waiter takes food order to chef 
  *
- *  Waiter updates state and then takes food request to chef.
+ *  Waiter updates state and then posts the food request to the chefs.
  *  Waiter should inform group that request is received.
- *  Waiter should wait for chef receiving request.
+ *  Waiter does not wait for a chef to take the request: the dish ready is its completion notification.
  *  The internal state should be saved.
  *
+ *  \param id waiter id
+ *  \param n group id
  */
-static void informChef(int n)
+static void informChef(int id, int n)
 {
     int table;
+    SEMOP leave[3];
 
     if (semDown(semgid, sh->mutex) == -1) {                                                  /* enter critical region */
         perror("error on the down operation for semaphore access (WT)");
@@ -196,64 +300,77 @@ static void informChef(int n)
     }
 
     // Update the waiter state to reflect that it is taking food order to chef
-    sh->fSt.st.waiterStat = INFORM_CHEF;
+    beginUpdate(&sh->fSt);
+    WAITERSTAT(&sh->fSt)[id] = INFORM_CHEF;
     saveState(nFic, &sh->fSt); 
+    endUpdate(&sh->fSt);
 
-    // Inform the chef of the group that ordered food
-    sh->fSt.foodGroup = n;
-    sh->fSt.foodOrder = 1;
+    table = ASSIGNEDTABLE(&sh->fSt)[n];      //identify the table assigned to the group
 
-    if (semUp(semgid, sh->waitOrder) == -1) {
-        perror("error on the up operation for semaphore access");
+    if (semUp(semgid, sh->mutex) == -1) {                                                   /* exit critical region */
+        perror("error on the up operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
 
-    table = sh->fSt.assignedTable[n];      //identify the table assigned to the group
-
-    if (semDown(semgid, sh->orderReceived) == -1) {
-        perror("error on the down operation for semaphore access");
+    if (semDown(semgid, sh->kitchenLock) == -1) {                                           /* enter kitchen region */
+        perror("error on the down operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
 
-    if (semUp(semgid, sh->requestReceived[table]) == -1) {
-        perror("error on the down operation for semaphore access");
-        exit(EXIT_FAILURE);
-    }
+    // Inform the chefs of the group that ordered food
+    ORDERGROUP(&sh->fSt)[sh->fSt.orderHead++] = n;
 
-    if (semUp(semgid, sh->mutex) == -1) {                                                   /* exit critical region */
+    leave[0] = (SEMOP) { sh->waitOrder, SEMUP };
+    leave[1] = (SEMOP) { sh->kitchenLock, SEMUP };
+    leave[2] = (SEMOP) { sh->requestReceived + table, SEMUP };
+    if (semOpBatch(semgid, leave, 3) == -1) {         /* signal chefs, exit kitchen region and acknowledge group */
         perror("error on the up operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
+
+    flushState(nFic, &sh->fSt);
 }
 
+
+
 /**
  *  \brief waiter takes food to table 
  *
  *  Waiter updates its state and takes food to table, allowing the meal to start.
  *  Group must be informed that food is available.
+ *  The dishes ready that follow among the requests taken (up to FOODBATCH in all) are taken in the same pass:
+ *  the groups are informed, each one at its own table, by a single batch.
  *  The internal state should be saved.
  *
+ *  \param id waiter id
+ *  \param n group id
  */
-static void takeFoodToTable(int n)
+static void takeFoodToTable(int id, int n)
 {
+    SEMOP leave[FOODBATCH+1];
+    unsigned int nops = 0;
+
     if (semDown(semgid, sh->mutex) == -1) {                                                  /* enter critical region */
         perror("error on the down operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
 
-    sh->fSt.st.waiterStat = TAKE_TO_TABLE;
+    beginUpdate(&sh->fSt);
+    WAITERSTAT(&sh->fSt)[id] = TAKE_TO_TABLE;
     saveState(nFic, &sh->fSt); 
+    endUpdate(&sh->fSt);
 
-    // Inform the group that the food is available
-    if (semUp(semgid, *sh->foodArrived) == -1) {
-        perror("error on the up operation for semaphore access");
-        exit(EXIT_FAILURE);
-    }
-
-    // TODO Insert your code here
+    // Inform the groups, at their own tables, that the food is available and exit critical region
+    leave[nops++] = (SEMOP) { sh->foodArrived + ASSIGNEDTABLE(&sh->fSt)[n], SEMUP };
+    while ((nops < FOODBATCH) && (nextPending < nPending) && (pending[nextPending].reqType == FOODREADY))
+        leave[nops++] = (SEMOP) { sh->foodArrived + ASSIGNEDTABLE(&sh->fSt)[pending[nextPending++].reqGroup], SEMUP };
+    leave[nops++] = (SEMOP) { sh->mutex, SEMUP };
 
-    if (semUp(semgid, sh->mutex) == -1) {                                                  /* exit critical region */
+    if (semOpBatch(semgid, leave, nops) == -1) {
         perror("error on the up operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
+
+    flushState(nFic, &sh->fSt);
 }
+
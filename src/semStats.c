@@ -0,0 +1,277 @@
+/**
+ *  \file semStats.c (implementation file)
+ *
+ *  \brief Semaphore usage statistics.
+ *
+ *  Implementation of the operations defined in semStats.h, on top of those defined in semaphore.h:
+ *     \li creation of the statistics block
+ *     \li connection of an entity to the statistics block
+ *     \li destruction of the statistics block
+ *     \li access to the statistics of an entity on a semaphore
+ *     \li zeroing of the statistics
+ *     \li instrumented <em>down</em>, <em>up</em> and batch operations.
+ *
+ *  Each row is only written by the entity that owns it, so the entries are updated without
+ *  synchronization and are only read after all the entities terminated (or, in server mode, ended the run).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#define  SEMSTATS_IMPL
+#include "semStats.h"
+#include "sharedMemory.h"
+#include "simClock.h"
+
+#ifdef THREADED
+/** \brief storage class of the variables of the calling entity */
+#define  ENTITYLOCAL    __thread
+#else
+/** \brief storage class of the variables of the calling entity */
+#define  ENTITYLOCAL
+#endif
+
+/**
+ *  \brief Definition of the statistics block.
+ */
+typedef struct {
+    /** \brief number of rows (intervening entities) */
+    unsigned int nEntities;
+    /** \brief number of entries per row (semaphores of the set, including the unused location 0) */
+    unsigned int snum;
+    /** \brief entries, row by row */
+    SEM_STAT entry[];
+} STATS_BLOCK;
+
+/** \brief local address of the statistics block */
+static ENTITYLOCAL STATS_BLOCK *stats = NULL;
+
+/** \brief row of the calling entity (NULL if it records nothing) */
+static ENTITYLOCAL SEM_STAT *row = NULL;
+
+/* internal functions */
+
+static unsigned long long now (int semgid)
+{
+#ifdef SIMCLOCK
+    return simNow (semgid) * 1000;
+#else
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000 + (unsigned long long) ts.tv_nsec;
+#endif
+}
+
+static void record (SEM_STAT *e, unsigned long long t)
+{
+    e->waitTotal += t;
+    if (t > e->waitMax)
+       e->waitMax = t;
+}
+
+static void release (SEM_STAT *e, unsigned long long t)
+{
+    if (e->held)
+       e->holdTotal += t - e->heldSince;
+    e->held = false;
+}
+
+/**
+ *  \brief Creation of the statistics block (all entries zeroed).
+ *
+ *  The function fails if there is already a statistics block for the creation key <tt>key</tt>.
+ *
+ *  \param key creation key of the semaphore set
+ *  \param nEntities number of intervening entities (rows)
+ *  \param snum number of semaphores in the set
+ *
+ *  \return block identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int statsCreate (int key, unsigned int nEntities, unsigned int snum)
+{
+  int statid;                                                                                  /* block identifier */
+  size_t size = sizeof (STATS_BLOCK) + (size_t) nEntities * (snum+1) * sizeof (SEM_STAT);
+
+  if (size > (unsigned int) -1)
+     { errno = EFBIG;
+       return -1;
+     }
+  if ((statid = shmemCreate (STATSKEY (key), (unsigned int) size)) == -1)
+     return -1;
+  if (shmemAttach (statid, (void **) &stats) == -1)
+     return -1;
+  stats->nEntities = nEntities;
+  stats->snum = snum+1;
+  return statid;
+}
+
+/**
+ *  \brief Connection of the calling entity to the statistics block.
+ *
+ *  From then on, its operations are recorded in the row <tt>entity</tt>.
+ *
+ *  \param key creation key of the semaphore set
+ *  \param entity row of the calling entity
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int statsConnect (int key, unsigned int entity)
+{
+  int statid;                                                                                  /* block identifier */
+
+  if ((statid = shmemConnect (STATSKEY (key))) == -1)
+     return -1;
+  if (shmemAttach (statid, (void **) &stats) == -1)
+     return -1;
+  if (entity >= stats->nEntities)
+     { errno = EINVAL;
+       return -1;
+     }
+  row = &stats->entry[(size_t) entity * stats->snum];
+  return 0;
+}
+
+/**
+ *  \brief Destruction of the statistics block (by the process that created it).
+ *
+ *  \param statid block identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int statsDestroy (int statid)
+{
+  if (stats == NULL)
+     { errno = EINVAL;
+       return -1;
+     }
+  if (shmemDettach (stats) == -1)
+     return -1;
+  stats = NULL;
+  row = NULL;
+  return shmemDestroy (statid);
+}
+
+/**
+ *  \brief Access to the statistics of an entity on a semaphore (by the process that created the block).
+ *
+ *  \param entity row of the entity
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return pointer to the entry, or NULL if it is out of the block
+ */
+
+const SEM_STAT *statsEntry (unsigned int entity, unsigned int sindex)
+{
+  if ((stats == NULL) || (entity >= stats->nEntities) || (sindex >= stats->snum))
+     return NULL;
+  return &stats->entry[(size_t) entity * stats->snum + sindex];
+}
+
+/**
+ *  \brief Zeroing of all the entries (by the process that created the block, while no entity operates on the set).
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int statsClear (void)
+{
+  if (stats == NULL)
+     { errno = EINVAL;
+       return -1;
+     }
+  memset (stats->entry, 0, (size_t) stats->nEntities * stats->snum * sizeof (SEM_STAT));
+  return 0;
+}
+
+/**
+ *  \brief Instrumented <em>down</em> of a semaphore within the set (see semDown).
+ */
+
+int statDown (int semgid, unsigned int sindex)
+{
+  unsigned long long t0;
+  unsigned long c0;
+  int stat;
+
+  if (row == NULL)
+     return semDown (semgid, sindex);
+  c0 = semSyscalls ();
+  t0 = now (semgid);
+  stat = semDown (semgid, sindex);
+  row[sindex].heldSince = now (semgid);
+  row[sindex].held = true;
+  row[sindex].downs += 1;
+  row[sindex].syscalls += semSyscalls () - c0;
+  record (&row[sindex], row[sindex].heldSince - t0);
+  return stat;
+}
+
+/**
+ *  \brief Instrumented <em>up</em> of a semaphore within the set (see semUp).
+ */
+
+int statUp (int semgid, unsigned int sindex)
+{
+  unsigned long c0;
+  int stat;
+
+  if (row == NULL)
+     return semUp (semgid, sindex);
+  row[sindex].ups += 1;
+  release (&row[sindex], now (semgid));
+  c0 = semSyscalls ();
+  stat = semUp (semgid, sindex);
+  row[sindex].syscalls += semSyscalls () - c0;
+  return stat;
+}
+
+/**
+ *  \brief Instrumented batch of <em>down</em> and <em>up</em> operations (see semOpBatch).
+ *
+ *  The time spent in the batch and its system calls are charged to its first <em>down</em> operation (to its
+ *  first operation, if there is none).
+ */
+
+int statOpBatch (int semgid, SEMOP ops[], unsigned int nops)
+{
+  unsigned long long t0, t1;
+  unsigned long c0;
+  unsigned int n;
+  int first = -1;
+  int stat;
+
+  if (row == NULL)
+     return semOpBatch (semgid, ops, nops);
+  t0 = now (semgid);
+  for (n = 0; n < nops; n++)
+    if (ops[n].op > 0)
+       { row[ops[n].sindex].ups += ops[n].op;
+         release (&row[ops[n].sindex], t0);
+       }
+       else { row[ops[n].sindex].downs += -ops[n].op;
+              if (first == -1) first = (int) ops[n].sindex;
+            }
+  c0 = semSyscalls ();
+  stat = semOpBatch (semgid, ops, nops);
+  t1 = now (semgid);
+  row[(first != -1) ? first : ops[0].sindex].syscalls += semSyscalls () - c0;
+  if (first != -1)
+     record (&row[first], t1 - t0);
+  for (n = 0; n < nops; n++)
+    if (ops[n].op < 0)
+       { row[ops[n].sindex].heldSince = t1;
+         row[ops[n].sindex].held = true;
+       }
+  return stat;
+}
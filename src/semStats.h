@@ -0,0 +1,140 @@
+/**
+ *  \file semStats.h (interface file)
+ *
+ *  \brief Semaphore usage statistics.
+ *
+ *  Operations defined on the statistics of the operations on a set of semaphores:
+ *     \li creation of the statistics block
+ *     \li connection of an entity to the statistics block
+ *     \li destruction of the statistics block
+ *     \li access to the statistics of an entity on a semaphore
+ *     \li zeroing of the statistics.
+ *
+ *  With instrumentation enabled (SEMSTATS defined, <tt>make SEMSTATS=1</tt>) every intervening entity
+ *  owns a row of a shared memory block, with one entry per semaphore of the set, and the
+ *  <em>down</em>, <em>up</em> and batch operations of the files that include this header are
+ *  replaced by versions that, besides carrying out the operation, count it in the entry of the
+ *  semaphore and add the time spent in it to the waiting time of the semaphore. The time of a batch is charged to
+ *  its first <em>down</em> operation. The time from a <em>down</em> to the next <em>up</em> of the same semaphore
+ *  by the same entity is added to its holding time, which is the time the lock is held for the semaphores
+ *  used as locks (MUTEX and the like), and the system calls made by the backend in an operation (see
+ *  semSyscalls) are counted too. Time is virtual time with the virtual-time semaphore backend.
+ *  Without instrumentation only the connection is defined, and it does nothing.
+ */
+
+#ifndef SEMSTATS_H_
+#define SEMSTATS_H_
+
+#ifdef SEMSTATS
+
+#include <stdbool.h>
+
+#include "semaphore.h"
+
+/** \brief key of the shared memory block that stores the statistics of the set with creation key k */
+#define  STATSKEY(k)    ((k) ^ 0x7e000000)
+
+/**
+ *  \brief Definition of the statistics of an entity on a semaphore.
+ */
+typedef struct {
+    /** \brief number of <em>down</em> operations */
+    unsigned long downs;
+    /** \brief number of <em>up</em> operations */
+    unsigned long ups;
+    /** \brief cumulative time spent in <em>down</em> operations (in nanoseconds) */
+    unsigned long long waitTotal;
+    /** \brief maximum time spent in a <em>down</em> operation (in nanoseconds) */
+    unsigned long long waitMax;
+    /** \brief cumulative time from a <em>down</em> to the next <em>up</em> (in nanoseconds) */
+    unsigned long long holdTotal;
+    /** \brief end time of the last <em>down</em> */
+    unsigned long long heldSince;
+    /** \brief the last <em>down</em> is not yet followed by an <em>up</em> */
+    bool held;
+    /** \brief number of system calls made by the operations */
+    unsigned long syscalls;
+} SEM_STAT;
+
+/**
+ *  \brief Creation of the statistics block (all entries zeroed).
+ *
+ *  The function fails if there is already a statistics block for the creation key <tt>key</tt>.
+ *
+ *  \param key creation key of the semaphore set
+ *  \param nEntities number of intervening entities (rows)
+ *  \param snum number of semaphores in the set
+ *
+ *  \return block identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int statsCreate (int key, unsigned int nEntities, unsigned int snum);
+
+/**
+ *  \brief Connection of the calling entity to the statistics block.
+ *
+ *  From then on, its operations are recorded in the row <tt>entity</tt>.
+ *
+ *  \param key creation key of the semaphore set
+ *  \param entity row of the calling entity
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int statsConnect (int key, unsigned int entity);
+
+/**
+ *  \brief Destruction of the statistics block (by the process that created it).
+ *
+ *  \param statid block identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int statsDestroy (int statid);
+
+/**
+ *  \brief Access to the statistics of an entity on a semaphore (by the process that created the block).
+ *
+ *  \param entity row of the entity
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return pointer to the entry, or NULL if it is out of the block
+ */
+
+extern const SEM_STAT *statsEntry (unsigned int entity, unsigned int sindex);
+
+/**
+ *  \brief Zeroing of all the entries (by the process that created the block, while no entity operates on the set).
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int statsClear (void);
+
+/* instrumented operations (see semaphore.h) */
+
+extern int statDown (int semgid, unsigned int sindex);
+extern int statUp (int semgid, unsigned int sindex);
+extern int statOpBatch (int semgid, SEMOP ops[], unsigned int nops);
+
+#ifndef SEMSTATS_IMPL
+#define  semDown        statDown
+#define  semUp          statUp
+#define  semOpBatch     statOpBatch
+#endif
+
+#else
+
+static inline int statsConnect (int key, unsigned int entity)
+{
+    return 0;
+}
+
+#endif /* SEMSTATS */
+
+#endif /* SEMSTATS_H_ */
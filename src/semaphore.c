@@ -9,20 +9,35 @@
  *     \li destruction of a previously created set of semaphores
  *     \li signalling start of operations
  *     \li <em>down</em> of a semaphore within the set
- *     \li <em>up</em> of a semaphore within the set.
+ *     \li <em>down</em> of a semaphore within the set, with a timeout
+ *     \li <em>up</em> of a semaphore within the set
+ *     \li batch of <em>down</em> and <em>up</em> operations on semaphores within the set
+ *     \li reading the value of a semaphore within the set
+ *     \li setting the values of the semaphores within the set
+ *     \li counting the system calls made by the operations.
  *
  *  \author António Rui Borges - October 1995
  */
 
+#define _GNU_SOURCE                                                                           /* semtimedop */
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
 #include <assert.h>
 
+#include "semaphore.h"
+
 /** \brief access permission: user r-w */
 #define  MASK           0600
 
+/** \brief number of system calls made by the operations of the process (one semop each) */
+static unsigned long nSyscalls = 0;
+
 /**
  *  \brief Creation of a set of semaphores.
  *
@@ -116,9 +131,35 @@ int semDown (int semgid, unsigned int sindex)
 
   assert(sindex>0);
   down.sem_num = (unsigned short) sindex;
+  nSyscalls += 1;
   return semop (semgid, &down, 1);
 }
 
+/**
+ *  \brief <em>Down</em> of a semaphore within the set, with a timeout.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if
+ *  the <em>down</em> could not be carried out within the timeout (<tt>errno</tt> is then set to EAGAIN).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *  \param usec timeout (in microseconds)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDownTimed (int semgid, unsigned int sindex, unsigned int usec)
+{
+  struct sembuf down = { 0, -1, 0 };                                                      /* specific down operation */
+  struct timespec tmout = { usec / 1000000, (usec % 1000000) * 1000 };                                   /* timeout */
+
+  assert(sindex>0);
+  down.sem_num = (unsigned short) sindex;
+  nSyscalls += 1;
+  return semtimedop (semgid, &down, 1, &tmout);
+}
+
 /**
  *  \brief <em>Up</em> of a semaphore within the set.
  *
@@ -137,5 +178,114 @@ int semUp (int semgid, unsigned int sindex)
 
   assert(sindex>0);
   up.sem_num = (unsigned short) sindex;
+  nSyscalls += 1;
   return semop (semgid, &up, 1);
 }
+
+/**
+ *  \brief Batch of <em>down</em> and <em>up</em> operations on semaphores within the set.
+ *
+ *  The batch is carried out atomically by a single <tt>semop</tt>: the calling process blocks until
+ *  all the <em>down</em> operations can be carried out at once.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param ops operations to be carried out
+ *  \param nops number of operations (1 .. SEMBATCHMAX)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semOpBatch (int semgid, SEMOP ops[], unsigned int nops)
+{
+  struct sembuf batch[SEMBATCHMAX];                                                          /* batch of operations */
+  unsigned int n;
+
+  assert((nops>0) && (nops<=SEMBATCHMAX));
+  for (n = 0; n < nops; n++)
+    { assert((ops[n].sindex>0) && (ops[n].op!=0));
+      batch[n].sem_num = (unsigned short) ops[n].sindex;
+      batch[n].sem_op = (short) ops[n].op;
+      batch[n].sem_flg = 0;
+    }
+  nSyscalls += 1;
+  return semop (semgid, batch, nops);
+}
+
+/**
+ *  \brief Reading the value of a semaphore within the set.
+ *
+ *  The value is only a snapshot, meant for diagnostics: it may change at any time.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return value of the semaphore, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semGetValue (int semgid, unsigned int sindex)
+{
+  assert(sindex>0);
+  return semctl (semgid, (int) sindex, GETVAL);
+}
+
+/**
+ *  \brief Setting the values of the semaphores within the set.
+ *
+ *  The values of the whole set are read and written back at once (<tt>GETALL</tt> and <tt>SETALL</tt>).
+ *  Semaphores 1 .. <tt>snum</tt> take the values <tt>val[1]</tt> .. <tt>val[snum]</tt> (<tt>val[0]</tt> is not used);
+ *  the start of operations semaphore and those above <tt>snum</tt> keep theirs. No process may be blocked on,
+ *  or operating on, the semaphores being set, so the set is reset in place between runs.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param snum number of semaphores set
+ *  \param val values of the semaphores
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semSetAll (int semgid, unsigned int snum, const unsigned short val[])
+{
+  union semun { int val; struct semid_ds *buf; unsigned short *array; } arg;               /* semctl argument */
+  struct semid_ds ds;                                                                    /* status of the set */
+  unsigned short *all;                                                          /* values of the whole set */
+  unsigned int s;
+  int stat;
+
+  arg.buf = &ds;
+  if (semctl (semgid, 0, IPC_STAT, arg) == -1)
+     return -1;
+  if (snum >= ds.sem_nsems)
+     { errno = EINVAL;
+       return -1;
+     }
+  if ((all = malloc (ds.sem_nsems * sizeof (unsigned short))) == NULL)
+     return -1;
+  arg.array = all;
+  if ((stat = semctl (semgid, 0, GETALL, arg)) != -1)
+     { for (s = 1; s <= snum; s++)
+         all[s] = val[s];
+       stat = semctl (semgid, 0, SETALL, arg);
+     }
+  free (all);
+  return stat;
+}
+
+/**
+ *  \brief Counting the system calls made by the operations.
+ *
+ *  Only the calls made by the <em>down</em>, <em>up</em> and batch operations of the calling process (thread, in
+ *  the threaded build) are counted, so the count of an operation is the difference of two values.
+ *
+ *  \return number of system calls made so far
+ */
+
+unsigned long semSyscalls (void)
+{
+  return nSyscalls;
+}
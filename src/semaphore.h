@@ -9,7 +9,12 @@
  *     \li destruction of a previously created set of semaphores
  *     \li signalling start of operations
  *     \li <em>down</em> of a semaphore within the set
- *     \li <em>up</em> of a semaphore within the set.
+ *     \li <em>down</em> of a semaphore within the set, with a timeout
+ *     \li <em>up</em> of a semaphore within the set
+ *     \li batch of <em>down</em> and <em>up</em> operations on semaphores within the set
+ *     \li reading the value of a semaphore within the set
+ *     \li setting the values of the semaphores within the set
+ *     \li counting the system calls made by the operations.
  *
  *  \author António Rui Borges - October 1995
  */
@@ -17,6 +22,24 @@
 #ifndef SEMAPHORE_H_
 #define SEMAPHORE_H_
 
+/** \brief <em>up</em> operation in a batch */
+#define  SEMUP           1
+/** \brief <em>down</em> operation in a batch */
+#define  SEMDOWN        -1
+/** \brief maximum number of operations in a batch */
+#define  SEMBATCHMAX     8
+
+/**
+ *  \brief Definition of an operation in a batch.
+ */
+typedef struct {
+    /** \brief semaphore location in the set (1 .. snum) */
+    unsigned int sindex;
+    /** \brief value added to the semaphore (SEMUP, SEMDOWN, or any other non-zero value to carry out
+               several <em>up</em> or <em>down</em> operations at once) */
+    int op;
+} SEMOP;
+
 /**
  *  \brief Creation of a set of semaphores.
  *
@@ -85,6 +108,22 @@ extern int semSignal (int semgid);
 
 extern int semDown (int semgid, unsigned int sindex);
 
+/**
+ *  \brief <em>Down</em> of a semaphore within the set, with a timeout.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if
+ *  the <em>down</em> could not be carried out within the timeout (<tt>errno</tt> is then set to EAGAIN).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *  \param usec timeout (in microseconds; real time even with the virtual-time backend)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int semDownTimed (int semgid, unsigned int sindex, unsigned int usec);
+
 /**
  *  \brief <em>Up</em> of a semaphore within the set.
  *
@@ -99,4 +138,68 @@ extern int semDown (int semgid, unsigned int sindex);
 
 extern int semUp (int semgid, unsigned int sindex);
 
+/**
+ *  \brief Batch of <em>down</em> and <em>up</em> operations on semaphores within the set.
+ *
+ *  Typical uses are releasing the critical region and signalling another semaphore, or waiting on a
+ *  semaphore and then entering the critical region, with a single call.
+ *  With SVIPC the batch is carried out atomically by a single <tt>semop</tt>: the calling process
+ *  blocks until all the <em>down</em> operations can be carried out at once. Other implementations
+ *  may carry out the operations in the given order.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param ops operations to be carried out
+ *  \param nops number of operations (1 .. SEMBATCHMAX)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int semOpBatch (int semgid, SEMOP ops[], unsigned int nops);
+
+/**
+ *  \brief Reading the value of a semaphore within the set.
+ *
+ *  The value is only a snapshot, meant for diagnostics: it may change at any time.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return value of the semaphore, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int semGetValue (int semgid, unsigned int sindex);
+
+/**
+ *  \brief Setting the values of the semaphores within the set.
+ *
+ *  Semaphores 1 .. <tt>snum</tt> take the values <tt>val[1]</tt> .. <tt>val[snum]</tt> (<tt>val[0]</tt> is not used);
+ *  the start of operations semaphore and those above <tt>snum</tt> keep theirs. No process may be blocked on,
+ *  or operating on, the semaphores being set, so the set is reset in place between runs.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param snum number of semaphores set
+ *  \param val values of the semaphores
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int semSetAll (int semgid, unsigned int snum, const unsigned short val[]);
+
+/**
+ *  \brief Counting the system calls made by the operations.
+ *
+ *  Only the calls made by the <em>down</em>, <em>up</em> and batch operations of the calling process (thread, in
+ *  the threaded build) are counted, so the count of an operation is the difference of two values.
+ *
+ *  \return number of system calls made so far
+ */
+
+extern unsigned long semSyscalls (void);
+
 #endif /* SEMAPHORE_H_ */
@@ -0,0 +1,469 @@
+/**
+ *  \file semaphoreFutex.c (implementation file)
+ *
+ *  \brief Semaphore management.
+ *
+ *  Futex based implementation of the operations defined in semaphore.h:
+ *     \li creation of a set of semaphores
+ *     \li connection to a previously created set of semaphores
+ *     \li destruction of a previously created set of semaphores
+ *     \li signalling start of operations
+ *     \li <em>down</em> of a semaphore within the set
+ *     \li <em>down</em> of a semaphore within the set, with a timeout
+ *     \li <em>up</em> of a semaphore within the set
+ *     \li batch of <em>down</em> and <em>up</em> operations on semaphores within the set
+ *     \li reading the value of a semaphore within the set
+ *     \li setting the values of the semaphores within the set
+ *     \li counting the system calls made by the operations.
+ *
+ *  The counters are kept in a shared memory block, so <em>down</em> of a semaphore in
+ *  <em>green state</em> and <em>up</em> of a semaphore nobody waits on run entirely in user space;
+ *  the kernel is only called to block and to wake up blocked processes.
+ *  The block is created with a key derived from the key of the set, so the same key may also be
+ *  used for the shared memory region of the problem.
+ *  The identifier of the set is the identifier of the block.
+ *  In the threaded build (THREADED defined) the block is process-local and private futexes are used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "semaphore.h"
+#include "sharedMemory.h"
+
+/** \brief key of the shared memory block that stores the set with creation key k */
+#define  SEMSHMKEY(k)   ((k) ^ 0x7f000000)
+
+#ifdef THREADED
+/** \brief futex operation on a block that is only used by the threads of a single process */
+#define  FUTEXOP(op)    ((op) | FUTEX_PRIVATE_FLAG)
+/** \brief storage class of the variables of the calling entity */
+#define  ENTITYLOCAL    __thread
+#else
+/** \brief futex operation on a block shared among processes */
+#define  FUTEXOP(op)    (op)
+/** \brief storage class of the variables of the calling entity */
+#define  ENTITYLOCAL
+#endif
+
+/** \brief maximum number of sets a process may be connected to */
+#define  MAXSETS        8
+
+/**
+ *  \brief Definition of a futex based semaphore.
+ */
+typedef struct {
+    /** \brief semaphore value */
+    int val;
+    /** \brief number of processes blocked (or about to block) on the semaphore */
+    int waiters;
+} FSEM;
+
+/**
+ *  \brief Definition of a set of semaphores.
+ */
+typedef struct {
+    /** \brief start of operations flag (futex) */
+    int started;
+    /** \brief number of semaphores in the set, including the start of operations one */
+    unsigned int snum;
+    /** \brief semaphores */
+    FSEM sem[];
+} FSEM_SET;
+
+/** \brief identifiers of the sets the process is connected to */
+static int setId[MAXSETS];
+
+/** \brief local addresses of the sets the process is connected to */
+static FSEM_SET *setAdd[MAXSETS];
+
+/** \brief number of sets the process is connected to */
+static int nSets = 0;
+
+/** \brief number of system calls (futex waits and wakes) made by the operations of the calling entity */
+static ENTITYLOCAL unsigned long nSyscalls = 0;
+
+/* internal functions */
+
+static int futexWait (int *addr, int val, const struct timespec *tmout)
+{
+    nSyscalls += 1;
+    return (int) syscall (SYS_futex, addr, FUTEXOP (FUTEX_WAIT), val, tmout, NULL, 0);
+}
+
+static unsigned long long now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000 + (unsigned long long) ts.tv_nsec;
+}
+
+static int futexWake (int *addr, int n)
+{
+    nSyscalls += 1;
+    return (int) syscall (SYS_futex, addr, FUTEXOP (FUTEX_WAKE), n, NULL, NULL, 0);
+}
+
+static int attachSet (int semgid)
+{
+    void *add;
+    int s;
+
+    for (s = 0; s < nSets; s++)                         /* already connected (by another thread) */
+        if (setId[s] == semgid)
+            return 0;
+    if (nSets == MAXSETS) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (shmemAttach (semgid, &add) != 0)
+        return -1;
+    setId[nSets] = semgid;
+    setAdd[nSets] = (FSEM_SET *) add;
+    nSets += 1;
+    return 0;
+}
+
+static FSEM_SET *findSet (int semgid)
+{
+    int s;
+
+    for (s = 0; s < nSets; s++)
+        if (setId[s] == semgid)
+            return setAdd[s];
+    errno = EINVAL;
+    return NULL;
+}
+
+/**
+ *  \brief Creation of a set of semaphores.
+ *
+ *  All semaphores in the set will be in set to <em>red state</em> upon creation.
+ *  The function fails if there is already a semaphore set with a creation key equal to <tt>key</tt>.
+ *
+ *  \param key creation key
+ *  \param snum number of semaphores in the set (>= 1)
+ *
+ *  \return set identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semCreate (int key, unsigned int snum)
+{
+  int semgid;                                                                            /* semaphore set identifier */
+  FSEM_SET *set;
+  unsigned int s;
+
+  if ((semgid = shmemCreate (SEMSHMKEY (key), sizeof (FSEM_SET) + (snum+1) * sizeof (FSEM))) == -1)
+     return -1;
+  if (attachSet (semgid) == -1)
+     return -1;
+  set = findSet (semgid);
+  set->started = 0;
+  set->snum = snum+1;
+  for (s = 0; s <= snum; s++)
+    { set->sem[s].val = 0;
+      set->sem[s].waiters = 0;
+    }
+  return semgid;
+}
+
+/**
+ *  \brief Connection to a previously created set of semaphores.
+ *
+ *  The function fails if there is no semaphore set with a creation key equal to <tt>key</tt>.
+ *  It only returns after the start of operations is signalled.
+ *
+ *  \param key creation key
+ *
+ *  \return set identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semConnect (int key)
+{
+  int semgid;                                                                            /* semaphore set identifier */
+  FSEM_SET *set;
+
+  if ((semgid = shmemConnect (SEMSHMKEY (key))) == -1)
+     return -1;
+  if (attachSet (semgid) == -1)
+     return -1;
+  set = findSet (semgid);
+  while (__atomic_load_n (&set->started, __ATOMIC_ACQUIRE) == 0)
+    futexWait (&set->started, 0, NULL);
+  return semgid;
+}
+
+/**
+ *  \brief Destruction of a previously created set of semaphores.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDestroy (int semgid)
+{
+  FSEM_SET *set;
+  int s;
+
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  for (s = 0; setId[s] != semgid; s++);
+  setId[s] = setId[nSets-1];
+  setAdd[s] = setAdd[nSets-1];
+  nSets -= 1;
+  if (shmemDettach (set) == -1)
+     return -1;
+  return shmemDestroy (semgid);
+}
+
+/**
+ *  \brief Signalling start of operations upon initialization of shared data structures.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semSignal (int semgid)
+{
+  FSEM_SET *set;
+
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  __atomic_store_n (&set->started, 1, __ATOMIC_RELEASE);
+  futexWake (&set->started, __INT_MAX__);
+  return 0;
+}
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDown (int semgid, unsigned int sindex)
+{
+  FSEM_SET *set;
+  FSEM *sem;
+  int val;
+
+  assert(sindex>0);
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  assert(sindex<set->snum);
+  sem = &set->sem[sindex];
+
+  for (;;)
+    { val = __atomic_load_n (&sem->val, __ATOMIC_SEQ_CST);
+      while (val > 0)
+        if (__atomic_compare_exchange_n (&sem->val, &val, val-1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+           return 0;
+      __atomic_fetch_add (&sem->waiters, 1, __ATOMIC_SEQ_CST);
+      if ((futexWait (&sem->val, 0, NULL) == -1) && (errno != EAGAIN) && (errno != EINTR))
+         { __atomic_fetch_sub (&sem->waiters, 1, __ATOMIC_SEQ_CST);
+           return -1;
+         }
+      __atomic_fetch_sub (&sem->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set, with a timeout.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if
+ *  the <em>down</em> could not be carried out within the timeout (<tt>errno</tt> is then set to EAGAIN).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *  \param usec timeout (in microseconds)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDownTimed (int semgid, unsigned int sindex, unsigned int usec)
+{
+  FSEM_SET *set;
+  FSEM *sem;
+  struct timespec left;                                                                 /* time left to wait */
+  unsigned long long deadline, t;
+  int val;
+
+  assert(sindex>0);
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  assert(sindex<set->snum);
+  sem = &set->sem[sindex];
+  deadline = now () + (unsigned long long) usec * 1000;
+
+  for (;;)
+    { val = __atomic_load_n (&sem->val, __ATOMIC_SEQ_CST);
+      while (val > 0)
+        if (__atomic_compare_exchange_n (&sem->val, &val, val-1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+           return 0;
+      if ((t = now ()) >= deadline)
+         { errno = EAGAIN;
+           return -1;
+         }
+      left.tv_sec = (time_t) ((deadline - t) / 1000000000);
+      left.tv_nsec = (long) ((deadline - t) % 1000000000);
+      __atomic_fetch_add (&sem->waiters, 1, __ATOMIC_SEQ_CST);
+      if ((futexWait (&sem->val, 0, &left) == -1) && (errno != EAGAIN) && (errno != EINTR) && (errno != ETIMEDOUT))
+         { __atomic_fetch_sub (&sem->waiters, 1, __ATOMIC_SEQ_CST);
+           return -1;
+         }
+      __atomic_fetch_sub (&sem->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ *  \brief <em>Up</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semUp (int semgid, unsigned int sindex)
+{
+  FSEM_SET *set;
+  FSEM *sem;
+
+  assert(sindex>0);
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  assert(sindex<set->snum);
+  sem = &set->sem[sindex];
+
+  __atomic_fetch_add (&sem->val, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n (&sem->waiters, __ATOMIC_SEQ_CST) > 0)
+     futexWake (&sem->val, 1);
+  return 0;
+}
+
+/**
+ *  \brief Batch of <em>down</em> and <em>up</em> operations on semaphores within the set.
+ *
+ *  The operations are carried out in the given order.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param ops operations to be carried out
+ *  \param nops number of operations (1 .. SEMBATCHMAX)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semOpBatch (int semgid, SEMOP ops[], unsigned int nops)
+{
+  unsigned int n;
+  int k;
+
+  assert((nops>0) && (nops<=SEMBATCHMAX));
+  for (n = 0; n < nops; n++)
+    { assert(ops[n].op!=0);
+      for (k = 0; k < abs (ops[n].op); k++)
+        if (((ops[n].op > 0) ? semUp (semgid, ops[n].sindex) : semDown (semgid, ops[n].sindex)) == -1)
+           return -1;
+    }
+  return 0;
+}
+
+/**
+ *  \brief Reading the value of a semaphore within the set.
+ *
+ *  The value is only a snapshot, meant for diagnostics: it may change at any time.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return value of the semaphore, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semGetValue (int semgid, unsigned int sindex)
+{
+  FSEM_SET *set;
+
+  assert(sindex>0);
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  assert(sindex<set->snum);
+  return __atomic_load_n (&set->sem[sindex].val, __ATOMIC_SEQ_CST);
+}
+
+/**
+ *  \brief Setting the values of the semaphores within the set.
+ *
+ *  Semaphores 1 .. <tt>snum</tt> take the values <tt>val[1]</tt> .. <tt>val[snum]</tt> (<tt>val[0]</tt> is not used);
+ *  the start of operations semaphore and those above <tt>snum</tt> keep theirs. No process may be blocked on,
+ *  or operating on, the semaphores being set, so the set is reset in place between runs.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param snum number of semaphores set
+ *  \param val values of the semaphores
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semSetAll (int semgid, unsigned int snum, const unsigned short val[])
+{
+  FSEM_SET *set;
+  unsigned int s;
+
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  if (snum >= set->snum)
+     { errno = EINVAL;
+       return -1;
+     }
+  for (s = 1; s <= snum; s++)
+    __atomic_store_n (&set->sem[s].val, (int) val[s], __ATOMIC_SEQ_CST);
+  return 0;
+}
+
+/**
+ *  \brief Counting the system calls made by the operations.
+ *
+ *  Only the calls made by the <em>down</em>, <em>up</em> and batch operations of the calling process (thread, in
+ *  the threaded build) are counted, so the count of an operation is the difference of two values.
+ *
+ *  \return number of system calls made so far
+ */
+
+unsigned long semSyscalls (void)
+{
+  return nSyscalls;
+}
@@ -0,0 +1,668 @@
+/**
+ *  \file semaphoreSim.c (implementation file)
+ *
+ *  \brief Semaphore management and simulated time.
+ *
+ *  Virtual-time implementation of the operations defined in semaphore.h and simClock.h:
+ *     \li creation of a set of semaphores
+ *     \li connection to a previously created set of semaphores
+ *     \li destruction of a previously created set of semaphores
+ *     \li signalling start of operations
+ *     \li <em>down</em> of a semaphore within the set
+ *     \li <em>down</em> of a semaphore within the set, with a timeout
+ *     \li <em>up</em> of a semaphore within the set
+ *     \li batch of <em>down</em> and <em>up</em> operations on semaphores within the set
+ *     \li reading the value of a semaphore within the set
+ *     \li setting the values of the semaphores within the set
+ *     \li counting the system calls made by the operations
+ *     \li setting the number of intervening entities
+ *     \li letting time pass for the calling entity
+ *     \li reading the present time
+ *     \li signalling the end of the calling entity.
+ *
+ *  The set is kept in a shared memory block, like in the futex implementation, and is protected by a
+ *  single process-shared mutex, which also protects the clock and the number of active entities (those
+ *  that are neither letting time pass nor blocked on a semaphore). When that number drops to zero, the
+ *  clock jumps to the earliest wake time and the entities due at that time become active again.
+ *  An <em>up</em> on a semaphore with blocked entities hands the unit straight to one of them and
+ *  counts it as active at once, so the clock never moves while an entity is about to resume.
+ *  At most <tt>snum</tt> entities may let time pass at the same time.
+ *  The system calls counted are the waits on, and the signals to, the condition variables of blocked entities
+ *  (those that go through a futex); the process-shared mutex is not counted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "semaphore.h"
+#include "simClock.h"
+#include "sharedMemory.h"
+
+/** \brief key of the shared memory block that stores the set with creation key k */
+#define  SEMSHMKEY(k)   ((k) ^ 0x7f000000)
+
+/** \brief maximum number of sets a process may be connected to */
+#define  MAXSETS        8
+
+#ifdef THREADED
+/** \brief storage class of the variables of the calling entity */
+#define  ENTITYLOCAL    __thread
+#else
+/** \brief storage class of the variables of the calling entity */
+#define  ENTITYLOCAL
+#endif
+
+/* states of a sleeper slot */
+#define  FREE           0
+#define  ASLEEP         1
+#define  AWAKE          2
+
+/**
+ *  \brief Definition of a semaphore.
+ */
+typedef struct {
+    /** \brief semaphore value */
+    int val;
+    /** \brief number of entities blocked on the semaphore */
+    int waiting;
+    /** \brief number of units handed to blocked entities that did not resume yet */
+    int granted;
+    /** \brief condition where the entities block */
+    pthread_cond_t cond;
+} SSEM;
+
+/**
+ *  \brief Definition of an entity letting time pass.
+ */
+typedef struct {
+    /** \brief slot state (FREE, ASLEEP or AWAKE) */
+    int state;
+    /** \brief wake time */
+    unsigned long long wake;
+    /** \brief condition where the entity waits for its wake time */
+    pthread_cond_t cond;
+} SLEEPER;
+
+/**
+ *  \brief Definition of a set of semaphores and of the clock.
+ */
+typedef struct {
+    /** \brief mutual exclusion of the whole set */
+    pthread_mutex_t lock;
+    /** \brief condition where the entities wait for the start of operations */
+    pthread_cond_t start;
+    /** \brief start of operations flag */
+    int started;
+    /** \brief deadlock already reported flag */
+    int stuck;
+    /** \brief number of semaphores in the set, including the unused location 0 */
+    unsigned int snum;
+    /** \brief number of active entities */
+    int nActive;
+    /** \brief present time (in microseconds) */
+    unsigned long long now;
+    /** \brief semaphores, followed by <tt>snum</tt> sleeper slots */
+    SSEM sem[];
+} SSEM_SET;
+
+/** \brief sleeper slots of the set s */
+#define  SLEEPERS(s)    ((SLEEPER *) &(s)->sem[(s)->snum])
+
+/** \brief identifiers of the sets the process is connected to */
+static int setId[MAXSETS];
+
+/** \brief local addresses of the sets the process is connected to */
+static SSEM_SET *setAdd[MAXSETS];
+
+/** \brief number of sets the process is connected to */
+static int nSets = 0;
+
+/** \brief number of system calls made by the operations of the calling entity */
+static ENTITYLOCAL unsigned long nSyscalls = 0;
+
+/* internal functions */
+
+static int attachSet (int semgid)
+{
+    void *add;
+    int s;
+
+    for (s = 0; s < nSets; s++)                         /* already connected (by another thread) */
+        if (setId[s] == semgid)
+            return 0;
+    if (nSets == MAXSETS) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (shmemAttach (semgid, &add) != 0)
+        return -1;
+    setId[nSets] = semgid;
+    setAdd[nSets] = (SSEM_SET *) add;
+    nSets += 1;
+    return 0;
+}
+
+static SSEM_SET *findSet (int semgid)
+{
+    int s;
+
+    for (s = 0; s < nSets; s++)
+        if (setId[s] == semgid)
+            return setAdd[s];
+    errno = EINVAL;
+    return NULL;
+}
+
+/* the calling entity stops being active (the lock must be held); if it was the last one, the clock
+   moves to the earliest wake time and the entities due at that time become active */
+static void deactivate (SSEM_SET *set)
+{
+    SLEEPER *sl = SLEEPERS (set);
+    unsigned long long next = 0;
+    unsigned int k;
+    bool found = false;
+
+    if (--set->nActive > 0)
+       return;
+    for (k = 0; k < set->snum; k++)
+      if ((sl[k].state == ASLEEP) && (!found || (sl[k].wake < next)))
+         { next = sl[k].wake;
+           found = true;
+         }
+    if (!found)
+       { for (k = 1; k < set->snum; k++)
+           if ((set->sem[k].waiting > set->sem[k].granted) && !set->stuck)
+              { fprintf (stderr, "deadlock at virtual time %llu us: all entities are blocked\n", set->now);
+                set->stuck = 1;
+              }
+         return;
+       }
+    set->now = next;
+    for (k = 0; k < set->snum; k++)
+      if ((sl[k].state == ASLEEP) && (sl[k].wake == next))
+         { sl[k].state = AWAKE;
+           set->nActive += 1;
+           pthread_cond_signal (&sl[k].cond);
+         }
+}
+
+/**
+ *  \brief Creation of a set of semaphores.
+ *
+ *  All semaphores in the set will be in set to <em>red state</em> upon creation.
+ *  The function fails if there is already a semaphore set with a creation key equal to <tt>key</tt>.
+ *
+ *  \param key creation key
+ *  \param snum number of semaphores in the set (>= 1)
+ *
+ *  \return set identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semCreate (int key, unsigned int snum)
+{
+  int semgid;                                                                            /* semaphore set identifier */
+  SSEM_SET *set;
+  pthread_mutexattr_t mattr;
+  pthread_condattr_t cattr;
+  unsigned int s;
+
+  if ((semgid = shmemCreate (SEMSHMKEY (key), sizeof (SSEM_SET) + (snum+1) * (sizeof (SSEM) + sizeof (SLEEPER))))
+      == -1)
+     return -1;
+  if (attachSet (semgid) == -1)
+     return -1;
+  set = findSet (semgid);
+  pthread_mutexattr_init (&mattr);
+  pthread_mutexattr_setpshared (&mattr, PTHREAD_PROCESS_SHARED);
+  pthread_condattr_init (&cattr);
+  pthread_condattr_setpshared (&cattr, PTHREAD_PROCESS_SHARED);
+  pthread_mutex_init (&set->lock, &mattr);
+  pthread_cond_init (&set->start, &cattr);
+  set->started = 0;
+  set->stuck = 0;
+  set->snum = snum+1;
+  set->nActive = 0;
+  set->now = 0;
+  for (s = 0; s <= snum; s++)
+    { set->sem[s].val = 0;
+      set->sem[s].waiting = 0;
+      set->sem[s].granted = 0;
+      pthread_cond_init (&set->sem[s].cond, &cattr);
+      SLEEPERS (set)[s].state = FREE;
+      pthread_cond_init (&SLEEPERS (set)[s].cond, &cattr);
+    }
+  pthread_mutexattr_destroy (&mattr);
+  pthread_condattr_destroy (&cattr);
+  return semgid;
+}
+
+/**
+ *  \brief Connection to a previously created set of semaphores.
+ *
+ *  The function fails if there is no semaphore set with a creation key equal to <tt>key</tt>.
+ *  It only returns after the start of operations is signalled.
+ *
+ *  \param key creation key
+ *
+ *  \return set identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semConnect (int key)
+{
+  int semgid;                                                                            /* semaphore set identifier */
+  SSEM_SET *set;
+
+  if ((semgid = shmemConnect (SEMSHMKEY (key))) == -1)
+     return -1;
+  if (attachSet (semgid) == -1)
+     return -1;
+  set = findSet (semgid);
+  pthread_mutex_lock (&set->lock);
+  while (!set->started)
+    pthread_cond_wait (&set->start, &set->lock);
+  pthread_mutex_unlock (&set->lock);
+  return semgid;
+}
+
+/**
+ *  \brief Destruction of a previously created set of semaphores.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDestroy (int semgid)
+{
+  SSEM_SET *set;
+  int s;
+
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  for (s = 0; setId[s] != semgid; s++);
+  setId[s] = setId[nSets-1];
+  setAdd[s] = setAdd[nSets-1];
+  nSets -= 1;
+  if (shmemDettach (set) == -1)
+     return -1;
+  return shmemDestroy (semgid);
+}
+
+/**
+ *  \brief Signalling start of operations upon initialization of shared data structures.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semSignal (int semgid)
+{
+  SSEM_SET *set;
+
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  pthread_mutex_lock (&set->lock);
+  set->started = 1;
+  pthread_cond_broadcast (&set->start);
+  pthread_mutex_unlock (&set->lock);
+  return 0;
+}
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDown (int semgid, unsigned int sindex)
+{
+  SSEM_SET *set;
+  SSEM *sem;
+
+  assert(sindex>0);
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  assert(sindex<set->snum);
+  sem = &set->sem[sindex];
+
+  pthread_mutex_lock (&set->lock);
+  if (sem->val > 0)
+     sem->val -= 1;
+     else { sem->waiting += 1;
+            deactivate (set);
+            while (sem->granted == 0)
+              { nSyscalls += 1;
+                pthread_cond_wait (&sem->cond, &set->lock);
+              }
+            sem->granted -= 1;                           /* the unit was handed over and counted as active */
+            sem->waiting -= 1;
+          }
+  pthread_mutex_unlock (&set->lock);
+  return 0;
+}
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set, with a timeout.
+ *
+ *  The timeout is measured in real time, as it is meant to detect entities that are stuck, and the
+ *  virtual clock does not move while they are blocked on this semaphore and the others are stuck too.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if
+ *  the <em>down</em> could not be carried out within the timeout (<tt>errno</tt> is then set to EAGAIN).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *  \param usec timeout (in microseconds of real time)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDownTimed (int semgid, unsigned int sindex, unsigned int usec)
+{
+  SSEM_SET *set;
+  SSEM *sem;
+  struct timespec deadline;                                                                      /* end of the wait */
+  bool taken = true;
+
+  assert(sindex>0);
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  assert(sindex<set->snum);
+  sem = &set->sem[sindex];
+  clock_gettime (CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += usec / 1000000;
+  deadline.tv_nsec += (long) (usec % 1000000) * 1000;
+  if (deadline.tv_nsec >= 1000000000)
+     { deadline.tv_sec += 1;
+       deadline.tv_nsec -= 1000000000;
+     }
+
+  pthread_mutex_lock (&set->lock);
+  if (sem->val > 0)
+     sem->val -= 1;
+     else { sem->waiting += 1;
+            deactivate (set);
+            while (sem->granted == 0)
+              { nSyscalls += 1;
+                if (pthread_cond_timedwait (&sem->cond, &set->lock, &deadline) == ETIMEDOUT)
+                   break;
+              }
+            if (sem->granted > 0)
+               sem->granted -= 1;                        /* the unit was handed over and counted as active */
+               else { set->nActive += 1;                               /* timed out: active again, with no unit */
+                      taken = false;
+                    }
+            sem->waiting -= 1;
+          }
+  pthread_mutex_unlock (&set->lock);
+  if (!taken)
+     { errno = EAGAIN;
+       return -1;
+     }
+  return 0;
+}
+
+/**
+ *  \brief <em>Up</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semUp (int semgid, unsigned int sindex)
+{
+  SSEM_SET *set;
+  SSEM *sem;
+
+  assert(sindex>0);
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  assert(sindex<set->snum);
+  sem = &set->sem[sindex];
+
+  pthread_mutex_lock (&set->lock);
+  if (sem->waiting > sem->granted)
+     { sem->granted += 1;
+       set->nActive += 1;
+       nSyscalls += 1;
+       pthread_cond_signal (&sem->cond);
+     }
+     else sem->val += 1;
+  pthread_mutex_unlock (&set->lock);
+  return 0;
+}
+
+/**
+ *  \brief Batch of <em>down</em> and <em>up</em> operations on semaphores within the set.
+ *
+ *  The operations are carried out in the given order.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param ops operations to be carried out
+ *  \param nops number of operations (1 .. SEMBATCHMAX)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semOpBatch (int semgid, SEMOP ops[], unsigned int nops)
+{
+  unsigned int n;
+  int k;
+
+  assert((nops>0) && (nops<=SEMBATCHMAX));
+  for (n = 0; n < nops; n++)
+    { assert(ops[n].op!=0);
+      for (k = 0; k < abs (ops[n].op); k++)
+        if (((ops[n].op > 0) ? semUp (semgid, ops[n].sindex) : semDown (semgid, ops[n].sindex)) == -1)
+           return -1;
+    }
+  return 0;
+}
+
+/**
+ *  \brief Reading the value of a semaphore within the set.
+ *
+ *  The value is only a snapshot, meant for diagnostics: it may change at any time.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return value of the semaphore, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semGetValue (int semgid, unsigned int sindex)
+{
+  SSEM_SET *set;
+  int val;
+
+  assert(sindex>0);
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  assert(sindex<set->snum);
+  pthread_mutex_lock (&set->lock);
+  val = set->sem[sindex].val;
+  pthread_mutex_unlock (&set->lock);
+  return val;
+}
+
+/**
+ *  \brief Setting the values of the semaphores within the set.
+ *
+ *  Semaphores 1 .. <tt>snum</tt> take the values <tt>val[1]</tt> .. <tt>val[snum]</tt> (<tt>val[0]</tt> is not used);
+ *  the start of operations semaphore and those above <tt>snum</tt> keep theirs. No process may be blocked on,
+ *  or operating on, the semaphores being set, so the set is reset in place between runs.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param snum number of semaphores set
+ *  \param val values of the semaphores
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semSetAll (int semgid, unsigned int snum, const unsigned short val[])
+{
+  SSEM_SET *set;
+  unsigned int s;
+
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  if (snum >= set->snum)
+     { errno = EINVAL;
+       return -1;
+     }
+  pthread_mutex_lock (&set->lock);
+  for (s = 1; s <= snum; s++)
+    { assert(set->sem[s].waiting == 0);
+      set->sem[s].val = (int) val[s];
+    }
+  pthread_mutex_unlock (&set->lock);
+  return 0;
+}
+
+/**
+ *  \brief Counting the system calls made by the operations.
+ *
+ *  Only the calls made by the <em>down</em>, <em>up</em> and batch operations of the calling process (thread, in
+ *  the threaded build) are counted, so the count of an operation is the difference of two values.
+ *
+ *  \return number of system calls made so far
+ */
+
+unsigned long semSyscalls (void)
+{
+  return nSyscalls;
+}
+
+/**
+ *  \brief Setting the number of intervening entities (before the start of operations is signalled).
+ *
+ *  \param semgid set identifier
+ *  \param n number of entities that will use the set
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int simEntities (int semgid, unsigned int n)
+{
+  SSEM_SET *set;
+
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  pthread_mutex_lock (&set->lock);
+  set->nActive = (int) n;
+  pthread_mutex_unlock (&set->lock);
+  return 0;
+}
+
+/**
+ *  \brief Letting time pass for the calling entity.
+ *
+ *  \param semgid set identifier
+ *  \param usec time interval (in microseconds)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int simSleep (int semgid, unsigned int usec)
+{
+  SSEM_SET *set;
+  SLEEPER *sl;
+  unsigned int k;
+
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  if (usec == 0)
+     return 0;
+  sl = SLEEPERS (set);
+
+  pthread_mutex_lock (&set->lock);
+  for (k = 0; (k < set->snum) && (sl[k].state != FREE); k++);
+  if (k == set->snum)
+     { pthread_mutex_unlock (&set->lock);
+       errno = ENOSPC;
+       return -1;
+     }
+  sl[k].state = ASLEEP;
+  sl[k].wake = set->now + usec;
+  deactivate (set);
+  while (sl[k].state != AWAKE)
+    pthread_cond_wait (&sl[k].cond, &set->lock);
+  sl[k].state = FREE;                                                 /* counted as active when woken */
+  pthread_mutex_unlock (&set->lock);
+  return 0;
+}
+
+/**
+ *  \brief Reading the present time.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return present time (in microseconds; virtual time starts at 0 when operations start)
+ */
+
+unsigned long long simNow (int semgid)
+{
+  SSEM_SET *set;
+  unsigned long long now;
+
+  if ((set = findSet (semgid)) == NULL)
+     return 0;
+  pthread_mutex_lock (&set->lock);
+  now = set->now;
+  pthread_mutex_unlock (&set->lock);
+  return now;
+}
+
+/**
+ *  \brief Signalling the end of the calling entity (it does not use the set any more).
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int simDone (int semgid)
+{
+  SSEM_SET *set;
+
+  if ((set = findSet (semgid)) == NULL)
+     return -1;
+  pthread_mutex_lock (&set->lock);
+  deactivate (set);
+  pthread_mutex_unlock (&set->lock);
+  return 0;
+}
@@ -17,44 +17,88 @@
 #ifndef SHAREDDATASYNC_H_
 #define SHAREDDATASYNC_H_
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "probConst.h"
 #include "probDataStruct.h"
+#include "histogram.h"
+#include "semaphore.h"
+#include "simClock.h"
 
 /**
  *  \brief Definition of <em>shared information</em> data type.
+ *
+ *  In the cache-aligned layout (CACHEALIGN defined) the semaphore ids, which are not changed once the
+ *  run starts, the latencies, updated by every group, and the log buffer lie on cache lines of their own.
  */
 typedef struct
         { /** \brief full state of the problem */
           FULL_STAT fSt;
 
           /* semaphores ids */
-          /** \brief identification of critical region protection semaphore – val = 1 */
+          /** \brief identification of the state protection semaphore (entity states, groups waiting and
+                     table assignment, which make up the log) – val = 1 */
           unsigned int mutex;
-          /** \brief identification of semaphore used by receptionist to wait for groups - val = 0 */
+          /** \brief identification of the reception region protection semaphore (receptionist queue) – val = 1 */
+          unsigned int receptionLock;
+          /** \brief identification of the waiter region protection semaphore (waiter queue and dishes ready) – val = 1 */
+          unsigned int waiterLock;
+          /** \brief identification of the kitchen region protection semaphore (food orders) – val = 1 */
+          unsigned int kitchenLock;
+          /** \brief identification of semaphore used by receptionist to wait for groups (queued requests) - val = 0 */
           unsigned int receptionistReq;
-          /** \brief identification of semaphore used by groups to wait before issuing receptionist request - val = 1 */
+          /** \brief identification of semaphore used by groups to wait before issuing receptionist request (free slots)
+                     - val = REQQUEUESIZE */
           unsigned int receptionistRequestPossible;
-          /** \brief identification of semaphore used by waiter to wait for requests – val = 0  */
+          /** \brief identification of semaphore used by waiters to wait for requests (queued requests and dishes
+                     ready) – val = 0  */
           unsigned int waiterRequest;
-          /** \brief identification of semaphore used by groups and chef to wait before issuing waiter request - val = 1 */
+          /** \brief identification of semaphore used by groups to wait before issuing waiter request (free slots;
+                     the chefs post the dishes ready apart, so they do not take one) - val = REQQUEUESIZE */
           unsigned int waiterRequestPossible;
-          /** \brief identification of semaphore used by chef to wait for order – val = 0  */
+          /** \brief identification of semaphore used by chefs to wait for orders (orders issued) – val = 0  */
           unsigned int waitOrder;
-          /** \brief identification of semaphore used by waiter to wait for chef – val = 0  */
-          unsigned int orderReceived;
-          /** \brief identification of semaphore used by groups to wait for table – val = 0 */
-          unsigned int waitForTable[MAXGROUPS];
-          /** \brief identification of semaphore used by groups to wait for waiter ackowledge – val = 0  */
-          unsigned int requestReceived[NUMTABLES];
-          /** \brief identification of semaphore used by groups to wait for food – val = 0 */
-          unsigned int foodArrived[NUMTABLES];
-          /** \brief identification of semaphore used by groups to wait for payment completed – val = 0 */
-          unsigned int tableDone[NUMTABLES];
+          /** \brief identification of semaphore used by group 0 to wait for table (group g uses waitForTable+g) – val = 0 */
+          unsigned int waitForTable;
+          /** \brief identification of semaphore used by groups at table 0 to wait for waiter ackowledge
+                     (table t uses requestReceived+t) – val = 0  */
+          unsigned int requestReceived;
+          /** \brief identification of semaphore used by groups at table 0 to wait for food
+                     (table t uses foodArrived+t) – val = 0 */
+          unsigned int foodArrived;
+          /** \brief identification of semaphore used by groups at table 0 to wait for payment completed
+                     (table t uses tableDone+t) – val = 0 */
+          unsigned int tableDone;
+
+          /** \brief options of the shared region (SHMEM_PREFAULT and SHMEM_LOCK, see sharedMemory.h): every
+                     entity pre-faults its mapping before starting its life cycle */
+          unsigned int memOpt;
+
+          /** \brief seed of the run: every entity seeds its own generator (see rng.h) with it and its row
+                     in the semaphore statistics */
+          unsigned long long seed;
+
+          /** \brief number of intervening entities letting time pass (see passTime), which the watchdog takes
+                     as progress of the run */
+          unsigned int sleeping;
+
+          /** \brief latencies of the groups (LAT_TABLE, LAT_FOOD and LAT_CHECKOUT) */
+          HISTOGRAM latency[NLATENCY] HOTLINE;
+
+          /** \brief use of the tables under the table scheduling policy of the run (filled by the receptionist) */
+          TABLE_REPORT tables;
+
+          /** \brief intervening entities started by the generator (the sizes of the run in single mode) */
+          ENTITY_POOL pool;
+
+          /** \brief buffer of state records (used when logging mode is LOG_RING) */
+          LOG_BUFFER log;
 
         } SHARED_DATA;
 
 /** \brief number of semaphores in the set */
-#define SEM_NU               ( 7 + sh->fSt.nGroups + 3*NUMTABLES )
+#define SEM_NU               ( 9 + sh->fSt.nGroups + 3*sh->fSt.nTables )
 
 #define MUTEX                  1
 #define RECEPTIONISTREQ        2
@@ -62,10 +106,228 @@ typedef struct
 #define WAITERREQUEST          4
 #define WAITERREQUESTPOSSIBLE  5
 #define WAITORDER              6
-#define ORDERRECEIVED          7
-#define WAITFORTABLE           8
+#define RECEPTIONLOCK          7
+#define WAITERLOCK             8
+#define KITCHENLOCK            9
+#define WAITFORTABLE          10
 #define FOODARRIVED            (WAITFORTABLE+sh->fSt.nGroups)
-#define REQUESTRECEIVED        (FOODARRIVED+NUMTABLES)
-#define TABLEDONE              (REQUESTRECEIVED+NUMTABLES)
+#define REQUESTRECEIVED        (FOODARRIVED+sh->fSt.nTables)
+#define TABLEDONE              (REQUESTRECEIVED+sh->fSt.nTables)
+
+/** \brief number of intervening entities (rows of the semaphore statistics, see semStats.h) */
+#define ENT_NU               ( 1 + sh->fSt.nWaiters + sh->fSt.nChefs + sh->fSt.nGroups )
+
+#define ENTRECEPTIONIST        0
+#define ENTWAITER(w)           (1+(w))
+#define ENTCHEF(c)             (1+sh->fSt.nWaiters+(c))
+#define ENTGROUP(g)            (1+sh->fSt.nWaiters+sh->fSt.nChefs+(g))
+
+/** \brief number of entities of the pool (rows of the semaphore statistics, which are kept by the pool entity) */
+#define POOL_NU              ( 1 + sh->pool.nWaiters + sh->pool.nChefs + sh->pool.nGroups )
+
+#define POOLRECEPTIONIST       0
+#define POOLWAITER(w)          (1+(w))
+#define POOLCHEF(c)            (1+sh->pool.nWaiters+(c))
+#define POOLGROUP(g)           (1+sh->pool.nWaiters+sh->pool.nChefs+(g))
+
+/*
+ *  Lock hierarchy: a region lock (reception, waiter or kitchen) may be held while acquiring the
+ *  state lock (mutex), never the other way round.
+ *
+ *  Every update of the state is carried out with the state lock held and enclosed between
+ *  beginUpdate and endUpdate, so a reader that does not take the lock can detect a torn copy (a read
+ *  enclosed between beginRead and endRead is retried until endRead finds no update took place).
+ */
+
+/**
+ *  \brief marks the start of an update of the state (state lock must be held).
+ *
+ *  \param p_fSt pointer to the full internal state of the problem
+ */
+static inline void beginUpdate (FULL_STAT *p_fSt)
+{
+    __atomic_store_n (&p_fSt->seq, p_fSt->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+/**
+ *  \brief marks the end of an update of the state (state lock must be held).
+ *
+ *  \param p_fSt pointer to the full internal state of the problem
+ */
+static inline void endUpdate (FULL_STAT *p_fSt)
+{
+    __atomic_store_n (&p_fSt->seq, p_fSt->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  \brief marks the start of a read of the state without the state lock.
+ *
+ *  \param p_fSt pointer to the full internal state of the problem
+ *
+ *  \return sequence number of the state, to be checked by endRead
+ */
+static inline unsigned int beginRead (const FULL_STAT *p_fSt)
+{
+    return __atomic_load_n (&p_fSt->seq, __ATOMIC_ACQUIRE);
+}
+
+/**
+ *  \brief marks the end of a read of the state without the state lock.
+ *
+ *  \param p_fSt pointer to the full internal state of the problem
+ *  \param seq sequence number returned by beginRead
+ *
+ *  \return true, if no update took place during the read, false, if the copy may be torn and must be read again
+ */
+static inline bool endRead (const FULL_STAT *p_fSt, unsigned int seq)
+{
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    return ((seq & 1) == 0) && (__atomic_load_n (&p_fSt->seq, __ATOMIC_RELAXED) == seq);
+}
+
+/**
+ *  \brief lets time pass for the calling entity (see simSleep).
+ *
+ *  The entity is counted in <tt>sleeping</tt> meanwhile, so that a long meal or a long cooking, which does
+ *  not update the state, is not taken by the watchdog as a stalled run.
+ *
+ *  \param sh pointer to the shared region
+ *  \param semgid semaphore set access identifier
+ *  \param usec time interval (in microseconds)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+static inline int passTime (SHARED_DATA *sh, int semgid, unsigned int usec)
+{
+    int stat;
+
+    __atomic_add_fetch (&sh->sleeping, 1, __ATOMIC_RELAXED);
+    stat = simSleep (semgid, usec);
+    __atomic_sub_fetch (&sh->sleeping, 1, __ATOMIC_RELAXED);
+    return stat;
+}
+
+/**
+ *  \brief lays out the shared region: the fixed part, followed by the arrays indexed by group, by waiter
+ *         and by chef and, in LOG_RING mode, by the ring of state records.
+ *
+ *  The arrays of start and eat times, which are not changed once the run starts, come first; the chef
+ *  state array comes last. In the cache-aligned layout (CACHEALIGN defined) each array and each state
+ *  record starts on a cache line of its own.
+ *  If <tt>sh</tt> is NULL, only the size of the region is computed, so that it can be created first.
+ *  The offsets of the arrays are stored in the region and computed at runtime, so every entity must be
+ *  built from this tree: binaries built for the fixed layout of earlier versions cannot read the region.
+ *
+ *  \param sh pointer to the shared region (or NULL)
+ *  \param nGroups number of groups
+ *  \param nTables number of tables
+ *  \param nWaiters number of waiters
+ *  \param nChefs number of chefs
+ *  \param logMode logging mode
+ *
+ *  \return size in bytes of the shared region
+ */
+static inline size_t layoutSharedData (SHARED_DATA *sh, int nGroups, int nTables, int nWaiters, int nChefs,
+                                       unsigned int logMode)
+{
+    size_t size = LINEUP (sizeof (SHARED_DATA));
+    size_t arraySize = LINEUP ((size_t) nGroups * sizeof (int));
+    size_t workerSize = LINEUP ((size_t) nWaiters * sizeof (int)) + LINEUP ((size_t) nChefs * sizeof (int));
+    size_t recSize = LINEUP (LOGRECSIZE (nWaiters + nChefs, nGroups));
+
+    if (sh != NULL) {
+        sh->fSt.nGroups = nGroups;
+        sh->fSt.nTables = nTables;
+        sh->fSt.nWaiters = nWaiters;
+        sh->fSt.nChefs = nChefs;
+        sh->fSt.startTimeOff = size - offsetof (SHARED_DATA, fSt);
+        sh->fSt.eatTimeOff = sh->fSt.startTimeOff + arraySize;
+        sh->fSt.groupStatOff = sh->fSt.eatTimeOff + arraySize;
+        sh->fSt.assignedTableOff = sh->fSt.groupStatOff + arraySize;
+        sh->fSt.orderGroupOff = sh->fSt.assignedTableOff + arraySize;
+        sh->fSt.readyGroupOff = sh->fSt.orderGroupOff + arraySize;
+        sh->fSt.waiterStatOff = sh->fSt.readyGroupOff + arraySize;
+        sh->fSt.chefStatOff = sh->fSt.waiterStatOff + LINEUP ((size_t) nWaiters * sizeof (int));
+        sh->log.mode = logMode;
+        sh->log.recSize = (unsigned int) recSize;
+        sh->log.recOff = size + 6 * arraySize + workerSize - offsetof (SHARED_DATA, log);
+    }
+    size += 6 * arraySize + workerSize;
+    if (logMode == LOG_RING) {
+        size += LOGRINGSIZE * recSize;
+    }
+    return size;
+}
+
+/**
+ *  \brief waits for the start of the next run of an entity of the pool.
+ *
+ *  In single mode the entity takes part in one run, which starts at once. In server mode the end of the
+ *  previous run of the entity, if any, is signalled to the generator and the entity waits until the
+ *  generator starts the next one, or tells it to end.
+ *
+ *  \param sh pointer to the shared region
+ *  \param semgid semaphore set access identifier
+ *  \param e entity of the pool (POOLRECEPTIONIST, POOLWAITER, POOLCHEF or POOLGROUP)
+ *  \param started the entity took part in a run (false for the first call)
+ *
+ *  \return true, if a run starts, false, if the entity must end
+ */
+static inline bool startRun (SHARED_DATA *sh, int semgid, unsigned int e, bool *started)
+{
+    if (!sh->pool.server) {
+        if (*started) return false;
+        *started = true;
+        return true;
+    }
+    if (*started && (semUp (semgid, sh->pool.runDone) == -1)) {
+        perror ("error on the up operation for semaphore access (end of run)");
+        exit (EXIT_FAILURE);
+    }
+    *started = true;
+    if (semDown (semgid, sh->pool.nextRun + e) == -1) {
+        perror ("error on the down operation for semaphore access (start of run)");
+        exit (EXIT_FAILURE);
+    }
+    return !__atomic_load_n (&sh->pool.quit, __ATOMIC_ACQUIRE);
+}
+
+/**
+ *  \brief appends a request to a queue (the region lock of the queue must be held and a free slot reserved).
+ *
+ *  \param q pointer to the queue
+ *  \param type request id
+ *  \param group group that issues the request
+ */
+static inline void putRequest (REQ_QUEUE *q, int type, int group)
+{
+    request *r = &q->slot[q->head % REQQUEUESIZE];
+
+    r->reqType = type;
+    r->reqGroup = group;
+    q->head += 1;
+}
+
+/**
+ *  \brief takes the requests in a queue, up to a given number (the region lock of the queue must be held).
+ *
+ *  \param q pointer to the queue
+ *  \param req array where the requests are stored, in arrival order
+ *  \param max largest number of requests taken (at most REQQUEUESIZE)
+ *
+ *  \return number of requests taken
+ */
+static inline unsigned int takeRequests (REQ_QUEUE *q, request req[], unsigned int max)
+{
+    unsigned int n = 0;
+
+    while ((q->tail != q->head) && (n < max)) {
+        req[n++] = q->slot[q->tail % REQQUEUESIZE];
+        q->tail += 1;
+    }
+    return n;
+}
 
 #endif /* SHAREDDATASYNC_H_ */
@@ -5,17 +5,24 @@
  *
  *   Operations defined on shared memory:
  *      \li creation of a new block
+ *      \li creation of a new block backed by huge pages or locked in memory
  *      \li connection to a previously created block
  *      \li destruction of a previously created block
  *      \li mapping of the block previously created on the process address space
- *      \li unmapping of the block off the process address space.
+ *      \li unmapping of the block off the process address space
+ *      \li pre-faulting and locking of the pages of a mapped block.
  *
  *  \author António Rui Borges - October 1995
  */
 
 #include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+
+#include "sharedMemory.h"
 
 /** \brief access permission: user r-w */
 #define  MASK           0600
@@ -37,6 +44,38 @@ int shmemCreate (int key, unsigned int size)
   return shmget ((key_t) key, size, MASK | IPC_CREAT | IPC_EXCL);
 }
 
+/**
+ *  \brief Creation of a new block backed by huge pages or locked in memory.
+ *
+ *  The function fails if there is already a block of shared memory with a creation key equal to <tt>key</tt>,
+ *  or if the huge pages or the locked memory requested are not available.
+ *  With SHMEM_HUGE the size is rounded up by the kernel to a multiple of the huge page size; with
+ *  SHMEM_LOCK the pages of the block are not swapped out once they are touched (<tt>SHM_LOCK</tt>).
+ *
+ *  \param key creation key
+ *  \param size block size (in bytes)
+ *  \param opt options (SHMEM_HUGE and SHMEM_LOCK; SHMEM_PREFAULT is ignored)
+ *
+ *  \return block identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemCreateOpt (int key, unsigned int size, unsigned int opt)
+{
+  int shmid,                                                                                  /* block identifier */
+      err;                                                                                 /* error of SHM_LOCK */
+
+  if ((shmid = shmget ((key_t) key, size, MASK | IPC_CREAT | IPC_EXCL | ((opt & SHMEM_HUGE) ? SHM_HUGETLB : 0))) == -1)
+     return -1;
+  if ((opt & SHMEM_LOCK) && (shmctl (shmid, SHM_LOCK, (struct shmid_ds *) NULL) == -1))
+     { err = errno;
+       shmctl (shmid, IPC_RMID, (struct shmid_ds *) NULL);
+       errno = err;
+       return -1;
+     }
+  return shmid;
+}
+
 /**
  *  \brief Connection to a previously created block.
  *
@@ -109,3 +148,36 @@ int shmemDettach (void *attAdd)
 {
   return shmdt (attAdd);
 }
+
+/**
+ *  \brief Pre-faulting and locking of the pages of a mapped block.
+ *
+ *  Every page of the mapping is written (without changing its contents, so other entities may be using the
+ *  block meanwhile) and, with SHMEM_LOCK, the mapping is locked in memory, so that later accesses do not
+ *  fault. Nothing is done if neither SHMEM_PREFAULT nor SHMEM_LOCK is set.
+ *  The function fails if there is no block with an identifier equal to <tt>shmid</tt>.
+ *
+ *  \param shmid block identifier
+ *  \param attAdd local address of the attached block
+ *  \param opt options (SHMEM_PREFAULT and SHMEM_LOCK; SHMEM_HUGE is ignored)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemPrefault (int shmid, void *attAdd, unsigned int opt)
+{
+  struct shmid_ds ds;                                                                       /* status of the block */
+  size_t page = (size_t) sysconf (_SC_PAGESIZE),                                                     /* page size */
+         n;                                                                                 /* offset in the block */
+
+  if ((opt & (SHMEM_PREFAULT | SHMEM_LOCK)) == 0)
+     return 0;
+  if (shmctl (shmid, IPC_STAT, &ds) == -1)
+     return -1;
+  for (n = 0; n < ds.shm_segsz; n += page)                       /* a write fault maps the page writable */
+    __atomic_fetch_or ((char *) attAdd + n, 0, __ATOMIC_RELAXED);
+  if (opt & SHMEM_LOCK)
+     return mlock (attAdd, ds.shm_segsz);
+  return 0;
+}
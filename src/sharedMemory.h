@@ -5,10 +5,12 @@
  *
  *   Operations defined on shared memory:
  *      \li creation of a new block
+ *      \li creation of a new block backed by huge pages or locked in memory
  *      \li connection to a previously created block
  *      \li destruction of a previously created block
  *      \li mapping of the block previously created on the process address space
- *      \li unmapping of the block off the process address space.
+ *      \li unmapping of the block off the process address space
+ *      \li pre-faulting and locking of the pages of a mapped block.
  *
  *  \author António Rui Borges - October 1995
  */
@@ -16,6 +18,14 @@
 #ifndef SHAREDMEMORY_H_
 #define SHAREDMEMORY_H_
 
+/* options of the creation and of the pre-faulting of a block */
+/** \brief the block is backed by huge pages */
+#define  SHMEM_HUGE     1
+/** \brief the pages of the block are touched when it is mapped, so they do not fault later */
+#define  SHMEM_PREFAULT 2
+/** \brief the pages of the block are locked in memory (pre-faulting them too) */
+#define  SHMEM_LOCK     4
+
 /**
  *  \brief Creation of a new block.
  *
@@ -30,6 +40,22 @@
 
 extern int shmemCreate (int key, unsigned int size);
 
+/**
+ *  \brief Creation of a new block backed by huge pages or locked in memory.
+ *
+ *  The function fails if there is already a block of shared memory with a creation key equal to <tt>key</tt>,
+ *  or if the huge pages or the locked memory requested are not available.
+ *
+ *  \param key creation key
+ *  \param size block size (in bytes)
+ *  \param opt options (SHMEM_HUGE and SHMEM_LOCK; SHMEM_PREFAULT is ignored)
+ *
+ *  \return block identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int shmemCreateOpt (int key, unsigned int size, unsigned int opt);
+
 /**
  *  \brief Connection to a previously created block.
  *
@@ -84,4 +110,22 @@ extern int shmemAttach (int shmid, void **pAttAdd);
 
 extern int shmemDettach (void *attAdd);
 
+/**
+ *  \brief Pre-faulting and locking of the pages of a mapped block.
+ *
+ *  Every page of the mapping is written (without changing its contents, so other entities may be using the
+ *  block meanwhile) and, with SHMEM_LOCK, the mapping is locked in memory, so that later accesses do not
+ *  fault. Nothing is done if neither SHMEM_PREFAULT nor SHMEM_LOCK is set.
+ *  The function fails if there is no block with an identifier equal to <tt>shmid</tt>.
+ *
+ *  \param shmid block identifier
+ *  \param attAdd local address of the attached block
+ *  \param opt options (SHMEM_PREFAULT and SHMEM_LOCK; SHMEM_HUGE is ignored)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int shmemPrefault (int shmid, void *attAdd, unsigned int opt);
+
 #endif /* SHAREDMEMORY_H_ */
@@ -0,0 +1,236 @@
+/**
+ *  \file sharedMemoryLocal.c (implementation file)
+ *
+ *  \brief Shared memory management.
+ *
+ *  In-process implementation of the operations defined in sharedMemory.h, used by the threaded build,
+ *  where all intervening entities are threads of the same process:
+ *      \li creation of a new block
+ *      \li creation of a new block backed by huge pages or locked in memory
+ *      \li connection to a previously created block
+ *      \li destruction of a previously created block
+ *      \li mapping of the block previously created on the process address space
+ *      \li unmapping of the block off the process address space
+ *      \li pre-faulting and locking of the pages of a mapped block.
+ *
+ *  The blocks are allocated on the heap, aligned on a page boundary like the blocks mapped by
+ *  <tt>shmat</tt>, and the keys are only meaningful inside the process.
+ *  Blocks must be created before the threads that connect to them are started and destroyed
+ *  after they terminate; connection, mapping and unmapping only read the table of blocks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "sharedMemory.h"
+
+/** \brief alignment of the blocks backed by huge pages (transparent huge pages of 2 MiB) */
+#define  HUGEALIGN      (2 * 1024 * 1024)
+
+/** \brief maximum number of blocks */
+#define  MAXBLOCKS      8
+
+/**
+ *  \brief Definition of a block of memory.
+ */
+typedef struct {
+    /** \brief creation key */
+    int key;
+    /** \brief local address (NULL if the entry is free) */
+    void *add;
+    /** \brief size in bytes */
+    size_t size;
+    /** \brief the block is locked in memory */
+    int locked;
+} BLOCK;
+
+/** \brief table of blocks (the identifier of a block is its position) */
+static BLOCK block[MAXBLOCKS];
+
+/**
+ *  \brief Creation of a new block.
+ *
+ *  The function fails if there is already a block of shared memory with a creation key equal to <tt>key</tt>.
+ *  The block is zero-filled.
+ *
+ *  \param key creation key
+ *  \param size block size (in bytes)
+ *
+ *  \return block identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemCreate (int key, unsigned int size)
+{
+  return shmemCreateOpt (key, size, 0);
+}
+
+/**
+ *  \brief Creation of a new block backed by huge pages or locked in memory.
+ *
+ *  The function fails if there is already a block of shared memory with a creation key equal to <tt>key</tt>.
+ *  The block is zero-filled.
+ *  With SHMEM_HUGE the block is aligned on a huge page boundary and transparent huge pages are requested
+ *  for it (a hint the kernel may ignore); SHMEM_LOCK only takes effect when the block is pre-faulted.
+ *
+ *  \param key creation key
+ *  \param size block size (in bytes)
+ *  \param opt options (SHMEM_HUGE and SHMEM_LOCK; SHMEM_PREFAULT is ignored)
+ *
+ *  \return block identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemCreateOpt (int key, unsigned int size, unsigned int opt)
+{
+  int b, id = -1;
+  size_t align = (opt & SHMEM_HUGE) ? HUGEALIGN : (size_t) sysconf (_SC_PAGESIZE);
+
+  for (b = 0; b < MAXBLOCKS; b++)
+    if (block[b].add == NULL)
+       { if (id == -1) id = b; }
+       else if (block[b].key == key)
+               { errno = EEXIST;
+                 return -1;
+               }
+  if (id == -1)
+     { errno = ENOSPC;
+       return -1;
+     }
+  if ((errno = posix_memalign (&block[id].add, align, size)) != 0)
+     { block[id].add = NULL;
+       return -1;
+     }
+#ifdef MADV_HUGEPAGE
+  if (opt & SHMEM_HUGE)
+     madvise (block[id].add, size, MADV_HUGEPAGE);
+#endif
+  memset (block[id].add, 0, size);
+  block[id].key = key;
+  block[id].size = size;
+  block[id].locked = 0;
+  return id;
+}
+
+/**
+ *  \brief Connection to a previously created block.
+ *
+ *  The function fails if there is no block with a creation key equal to <tt>key</tt>.
+ *
+ *  \param key creation key
+ *
+ *  \return block identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemConnect (int key)
+{
+  int b;
+
+  for (b = 0; b < MAXBLOCKS; b++)
+    if ((block[b].add != NULL) && (block[b].key == key))
+       return b;
+  errno = ENOENT;
+  return -1;
+}
+
+/**
+ *  \brief Destruction of a previously created block.
+ *
+ *  The function fails if there is no block with an identifier equal to <tt>shmid</tt>.
+ *
+ *  \param shmid block identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemDestroy (int shmid)
+{
+  if ((shmid < 0) || (shmid >= MAXBLOCKS) || (block[shmid].add == NULL))
+     { errno = EINVAL;
+       return -1;
+     }
+  if (block[shmid].locked)
+     munlock (block[shmid].add, block[shmid].size);
+  free (block[shmid].add);
+  block[shmid].add = NULL;
+  return 0;
+}
+
+/**
+ *  \brief Mapping of the block previously created on the process address space.
+ *
+ *  The function fails if there is no block with an identifier equal to <tt>shmid</tt>.
+ *
+ *  \param shmid block identifier
+ *  \param pAttAdd pointer to the location where the local address of the attached block is stored
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemAttach (int shmid, void **pAttAdd)
+{
+  if ((shmid < 0) || (shmid >= MAXBLOCKS) || (block[shmid].add == NULL))
+     { errno = EINVAL;
+       return -1;
+     }
+  *pAttAdd = block[shmid].add;
+  return 0;
+}
+
+/**
+ *  \brief Unmapping of the block off the process address space.
+ *
+ *  The block stays accessible to the other threads until it is destroyed, so nothing is done.
+ *
+ *  \param attAdd local address of the attached block
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemDettach (void *attAdd)
+{
+  int b;
+
+  for (b = 0; b < MAXBLOCKS; b++)
+    if ((block[b].add != NULL) && (block[b].add == attAdd))
+       return 0;
+  errno = EINVAL;
+  return -1;
+}
+
+/**
+ *  \brief Pre-faulting and locking of the pages of a mapped block.
+ *
+ *  The block was zero-filled on creation, so its pages are already in place; with SHMEM_LOCK they are
+ *  locked in memory. Nothing is done if neither SHMEM_PREFAULT nor SHMEM_LOCK is set.
+ *  The function fails if there is no block with an identifier equal to <tt>shmid</tt>.
+ *
+ *  \param shmid block identifier
+ *  \param attAdd local address of the attached block
+ *  \param opt options (SHMEM_PREFAULT and SHMEM_LOCK; SHMEM_HUGE is ignored)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemPrefault (int shmid, void *attAdd, unsigned int opt)
+{
+  if ((shmid < 0) || (shmid >= MAXBLOCKS) || (block[shmid].add == NULL) || (block[shmid].add != attAdd))
+     { errno = EINVAL;
+       return -1;
+     }
+  if (!(opt & SHMEM_LOCK) || block[shmid].locked)
+     return 0;
+  if (mlock (attAdd, block[shmid].size) == -1)
+     return -1;
+  block[shmid].locked = 1;
+  return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ *  \file simClock.h (interface file)
+ *
+ *  \brief Simulated time.
+ *
+ *  Operations defined on the clock of a simulation:
+ *     \li setting the number of intervening entities
+ *     \li letting time pass for the calling entity
+ *     \li reading the present time
+ *     \li signalling the end of the calling entity.
+ *
+ *  With the virtual-time semaphore backend (SIMCLOCK defined, <tt>make SEMBACKEND=sim</tt>) the clock is
+ *  kept with the semaphore set: an entity that lets time pass blocks until the clock reaches its wake
+ *  time, and the clock only moves forward, straight to the earliest wake time, when every entity is
+ *  either letting time pass or blocked on a semaphore. With the other backends real time is used.
+ */
+
+#ifndef SIMCLOCK_H_
+#define SIMCLOCK_H_
+
+#ifdef SIMCLOCK
+
+/**
+ *  \brief Setting the number of intervening entities (before the start of operations is signalled).
+ *
+ *  \param semgid set identifier
+ *  \param n number of entities that will use the set
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int simEntities (int semgid, unsigned int n);
+
+/**
+ *  \brief Letting time pass for the calling entity.
+ *
+ *  \param semgid set identifier
+ *  \param usec time interval (in microseconds)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int simSleep (int semgid, unsigned int usec);
+
+/**
+ *  \brief Reading the present time.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return present time (in microseconds; virtual time starts at 0 when operations start)
+ */
+
+extern unsigned long long simNow (int semgid);
+
+/**
+ *  \brief Signalling the end of the calling entity (it does not use the set any more).
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int simDone (int semgid);
+
+#else
+
+#include <unistd.h>
+#include <time.h>
+
+static inline int simEntities (int semgid, unsigned int n)
+{
+    return 0;
+}
+
+static inline int simSleep (int semgid, unsigned int usec)
+{
+    return (usec > 0) ? usleep (usec) : 0;
+}
+
+static inline unsigned long long simNow (int semgid)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000 + (unsigned long long) ts.tv_nsec / 1000;
+}
+
+static inline int simDone (int semgid)
+{
+    return 0;
+}
+
+#endif /* SIMCLOCK */
+
+#endif /* SIMCLOCK_H_ */